@@ -0,0 +1,21 @@
+TARGET=bench
+SOURCES+= main.cpp \
+          ../das/src/ColorMesh.cpp \
+          ../das/src/DynamicKdTree.cpp \
+          ../das/src/Graph.cpp \
+          ../das/src/KdTree.cpp \
+          ../das/src/MeshFile.cpp \
+          ../das/src/MeshLoader.cpp \
+          ../das/src/ParticleKernel.cpp \
+          ../das/src/ParticleSim.cpp \
+          ../das/src/ThreadPool.cpp \
+          ../das/src/Timeline.cpp
+
+INCLUDEPATH+= ../das/include
+DEFINES+= DAS_ASSET_DIR=\\\"$$PWD/../das/assets\\\"
+
+# timings are meaningless without optimisation
+CONFIG+= release
+
+# Following code written by Jon Macey
+include($$(HOME)/NGL/UseNGL.pri)
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ngl/Vec3.h>
+
+#include "ColorMesh.h"
+#include "Graph.h"
+#include "ParticleKernel.h"
+#include "ParticleSim.h"
+#include "ThreadPool.h"
+
+// bench.pro points this at das/assets
+#ifndef DAS_ASSET_DIR
+#define DAS_ASSET_DIR "../das/assets"
+#endif
+
+// Benchmarks for the particle simulation. Run as: bench [numParticles] [numSteps] [numRetargeted] [numVertices]
+
+namespace
+{
+
+// the per particle loop ParticleSim used before the step kernels, kept here as the baseline
+struct LegacyParticle
+{
+    ngl::Vec3 pos;
+    ngl::Vec3 target;
+    ngl::Vec3 dir;
+    float speed;
+};
+
+void legacyStep(std::vector<LegacyParticle> &_particles, float _dt)
+{
+    for(auto& p : _particles)
+    {
+        auto direction = p.target - p.pos;
+        direction.normalize();
+        if(direction != p.dir)
+        {
+            p.pos = p.target;
+            continue;
+        }
+        p.pos += direction * (p.speed * _dt);
+    }
+}
+
+template<typename F>
+double secondsFor(F _f)
+{
+    auto start = std::chrono::steady_clock::now();
+    _f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+void report(const char *_name, size_t _n, size_t _steps, double _seconds)
+{
+    std::cout << "  " << _name << ": " << _seconds * 1000.0 << " ms, "
+              << static_cast<double>(_n * _steps) / _seconds / 1.0e6 << " M particles/s\n";
+}
+
+// _side^3 grid of nodes, each linked to its nearest neighbours
+Graph gridGraph(size_t _side)
+{
+    std::vector<ngl::Vec3> points;
+    points.reserve(_side * _side * _side);
+    for(size_t i = 0; i < _side; ++i)
+    {
+        for(size_t j = 0; j < _side; ++j)
+        {
+            for(size_t k = 0; k < _side; ++k)
+            {
+                points.push_back(ngl::Vec3(0.1f * i, 0.1f * j, 0.1f * k));
+            }
+        }
+    }
+    return Graph(points, 6);
+}
+
+} // end of anonymous namespace
+
+int main(int argc, char **argv)
+{
+    size_t numParticles = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    size_t numSteps = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 100;
+    size_t numRetargeted = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 100000;
+    size_t numVertices = (argc > 4) ? std::strtoul(argv[4], nullptr, 10) : 1000000;
+    const float dt = 0.01f;
+
+    // particles heading along random unit directions towards targets a few hundred steps away
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<float> px(numParticles), py(numParticles), pz(numParticles);
+    std::vector<float> dx(numParticles), dy(numParticles), dz(numParticles);
+    std::vector<float> tx(numParticles), ty(numParticles), tz(numParticles);
+    std::vector<float> speed(numParticles, 0.5f);
+    std::vector<uint8_t> arrived(numParticles);
+    std::vector<LegacyParticle> legacy(numParticles);
+    for(size_t i = 0; i < numParticles; ++i)
+    {
+        ngl::Vec3 dir(unit(gen), unit(gen), unit(gen));
+        dir.normalize();
+        auto target = dir * (1.0f + unit(gen) * 0.5f);
+        px[i] = 0.0f; py[i] = 0.0f; pz[i] = 0.0f;
+        dx[i] = dir.m_x; dy[i] = dir.m_y; dz[i] = dir.m_z;
+        tx[i] = target.m_x; ty[i] = target.m_y; tz[i] = target.m_z;
+        legacy[i] = {ngl::Vec3(0.0f), target, dir, 0.5f};
+    }
+
+    std::cout << "particle step, " << numParticles << " particles x " << numSteps << " steps\n";
+    report("legacy loop", numParticles, numSteps, secondsFor([&]
+    {
+        for(size_t s = 0; s < numSteps; ++s)
+        {
+            legacyStep(legacy, dt);
+        }
+    }));
+    auto best = detectSimdLevel();
+    for(auto level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512})
+    {
+        if(static_cast<int>(level) > static_cast<int>(best))
+        {
+            continue;
+        }
+        auto x = px, y = py, z = pz;
+        ParticleStepData data = {x.data(), y.data(), z.data(),
+                                 dx.data(), dy.data(), dz.data(),
+                                 tx.data(), ty.data(), tz.data(),
+                                 speed.data(), arrived.data(), numParticles};
+        report(simdLevelName(level), numParticles, numSteps, secondsFor([&]
+        {
+            for(size_t s = 0; s < numSteps; ++s)
+            {
+                advanceParticles(data, dt, level);
+            }
+        }));
+    }
+    // best kernel spread over every core, the same way ParticleSim::animateParticles does it
+    auto threads = std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool pool(threads);
+    auto x = px, y = py, z = pz;
+    auto name = std::string(simdLevelName(best)) + " x " + std::to_string(threads) + " threads";
+    report(name.c_str(), numParticles, numSteps, secondsFor([&]
+    {
+        for(size_t s = 0; s < numSteps; ++s)
+        {
+            pool.parallelFor(numParticles, 4096, [&](size_t _begin, size_t _end)
+            {
+                ParticleStepData data = {&x[_begin], &y[_begin], &z[_begin],
+                                         &dx[_begin], &dy[_begin], &dz[_begin],
+                                         &tx[_begin], &ty[_begin], &tz[_begin],
+                                         &speed[_begin], &arrived[_begin], _end - _begin};
+                advanceParticles(data, dt);
+            });
+        }
+    }));
+
+    // goal changes, every particle has to be sent towards the new goal
+    const size_t side = 10;
+    const size_t goalChanges = 20;
+    auto graph = gridGraph(side);
+    std::cout << "goal change, " << numRetargeted << " particles on " << graph.size() << " nodes x "
+              << goalChanges << " changes\n";
+    // what ParticleSim used to do, one A* search per particle. Far too slow to run on everyone so time a
+    // sample and scale it up
+    size_t sampled = std::min<size_t>(numRetargeted, 2000);
+    std::uniform_int_distribution<size_t> anyNode(0, graph.size() - 1);
+    std::vector<size_t> from(sampled);
+    for(auto& f : from)
+    {
+        f = anyNode(gen);
+    }
+    auto perParticle = secondsFor([&]
+    {
+        for(size_t c = 0; c < goalChanges; ++c)
+        {
+            auto goal = anyNode(gen);
+            for(auto f : from)
+            {
+                graph.aStarNodes(f, goal);
+            }
+        }
+    });
+    report("A* per particle", numRetargeted, goalChanges,
+           perParticle * static_cast<double>(numRetargeted) / static_cast<double>(sampled));
+    ParticleSim sim(graph, 1234);
+    sim.setNumThreads(threads);
+    sim.setNumParticles(numRetargeted);
+    sim.step(dt);
+    report("ParticleSim::changeGoal", sim.size(), goalChanges, secondsFor([&]
+    {
+        for(size_t c = 0; c < goalChanges; ++c)
+        {
+            sim.changeGoal();
+        }
+    }));
+
+    // mesh colours from the nearest particles, per call as it runs once a frame. The UI allows up to 99 particles
+    const size_t calls = 20;
+    std::uniform_real_distribution<float> unitPositive(0.0f, 1.0f);
+    const std::string teapotPath = DAS_ASSET_DIR "/teapot.dasm";
+    ColorMesh teapot(teapotPath);
+    ColorMesh cloud;
+    std::vector<ngl::Vec3> cloudVertices(numVertices);
+    for(auto& v : cloudVertices)
+    {
+        v = ngl::Vec3(unit(gen), unit(gen), unit(gen));
+    }
+    cloud.setMesh(cloudVertices, {0, 0, 0});
+    for(size_t numColored : {99, 10000})
+    {
+        std::vector<ngl::Vec3> particles(numColored);
+        for(auto& p : particles)
+        {
+            p = ngl::Vec3(unitPositive(gen), unitPositive(gen), unitPositive(gen));
+        }
+        std::cout << "vertex colours from " << numColored << " particles, " << threads << " threads, ms per call\n";
+        for(auto mesh : {&teapot, &cloud})
+        {
+            if(mesh->empty())
+            {
+                std::cout << "  no teapot, couldn't load " << teapotPath << "\n";
+                continue;
+            }
+            std::vector<ngl::Vec3> out(mesh->numVertices());
+            for(auto mapping : {ColorMesh::Mapping::Repeat, ColorMesh::Mapping::Nearest, ColorMesh::Mapping::Blend})
+            {
+                mesh->setMapping(mapping);
+                auto seconds = secondsFor([&]
+                {
+                    for(size_t c = 0; c < calls; ++c)
+                    {
+                        mesh->mapColors(particles, particles, out.data(), &pool);
+                    }
+                });
+                const char *names[] = {"repeat", "nearest", "blend 4"};
+                std::cout << "  " << mesh->numVertices() << " vertices, " << names[static_cast<int>(mapping)]
+                          << ": " << seconds * 1000.0 / calls << " ms\n";
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
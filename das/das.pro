@@ -11,22 +11,56 @@ CONFIG-=app_bundle
 SOURCES+=src/main.cpp \
          src/NGLScene.cpp \
          src/Graph.cpp \
+         src/GraphBuilder.cpp \
+         src/GraphVersions.cpp \
+         src/KdTree.cpp \
+         src/DynamicKdTree.cpp \
          src/NGLSceneMouseControls.cpp \
          src/MainWindow.cpp \
-         src/ColorTeapot.cpp
+         src/ColorTeapot.cpp \
+         src/ColorMesh.cpp \
+         src/MeshFile.cpp \
+         src/MeshLoader.cpp \
+         src/MeshRenderer.cpp \
+         src/ParticleSim.cpp \
+         src/ParticleKernel.cpp \
+         src/ParticleRenderer.cpp \
+         src/SimulationThread.cpp \
+         src/ThreadPool.cpp \
+         src/Timeline.cpp
 
 HEADERS+= include/NGLScene.h \
           include/WindowParams.h \
           include/Graph.h \
+          include/GraphBuilder.h \
+          include/GraphVersions.h \
+          include/KdTree.h \
+          include/DynamicKdTree.h \
           include/MainWindow.h \
           include/ColorTeapot.h \
-          include/teapot.h
+          include/ColorMesh.h \
+          include/MeshFile.h \
+          include/MeshLoader.h \
+          include/MeshRenderer.h \
+          include/teapot.h \
+          include/ParticleSim.h \
+          include/ParticleKernel.h \
+          include/ParticleRenderer.h \
+          include/SimulationThread.h \
+          include/ThreadPool.h \
+          include/Philox.h \
+          include/Timeline.h \
+          include/FrameState.h \
+          include/TripleBuffer.h
 
-OTHER_FILES+= shaders/*.glsl
+OTHER_FILES+= shaders/*.glsl \
+              assets/*.dasm
 
 FORMS+= ui/MainWindow.ui
 
 INCLUDEPATH+= include
+# the teapot is found from here, wherever the program is run from
+DEFINES+= DAS_ASSET_DIR=\\\"$$PWD/assets\\\"
 
 cache()
 
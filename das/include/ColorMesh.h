@@ -0,0 +1,71 @@
+#ifndef COLORMESH_H_
+#define COLORMESH_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ngl/Vec3.h>
+#include "ThreadPool.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class ColorMesh
+/// @brief any external mesh coloured by the particles, the way ColorTeapot colours the teapot.
+/// The mesh is read once through MeshLoader and kept indexed. Colours are written a chunk of vertices at a time
+/// straight into memory the caller hands over, usually a mapped GL buffer, so a frame never builds a copy of the
+/// mesh and chunks can be filled by different threads.
+/// Colours are either the palette repeated over the vertices, or taken from the particle nearest each vertex, or
+/// blended from the few nearest. For those the mesh and the particles are each stretched to fill a unit cube, the
+/// shared space they are compared in, and a KdTree over the particles is built for each call.
+//----------------------------------------------------------------------------------------------------------------------
+class ColorMesh
+{
+public:
+    /// how vertices pick their colour in mapColors
+    enum class Mapping
+    {
+        Repeat,     // vertex i takes colour i % number of colours
+        Nearest,    // colour of the nearest particle
+        Blend       // inverse square distance blend of the blendCount() nearest particles
+    };
+    static constexpr size_t MaxBlend = 16;
+
+    ColorMesh()=default;
+    ColorMesh(const std::string &_path);
+    bool load(const std::string &_path);                // replaces the mesh, returns false and leaves it empty on failure
+    void setMesh(const std::vector<ngl::Vec3> &_vertices, const std::vector<uint32_t> &_indices);
+
+    bool empty() const { return m_indices.empty(); }
+    size_t numVertices() const { return m_vertices.size(); }
+    size_t numTris() const { return m_indices.size(); }     // returns number of triangle corners
+    const std::vector<ngl::Vec3>& vertices() const { return m_vertices; }
+    const std::vector<uint32_t>& indices() const { return m_indices; }
+    void setChunkSize(size_t _n) { m_chunkSize = _n > 0 ? _n : 1; }
+    size_t chunkSize() const { return m_chunkSize; }          // returns vertices coloured per task
+    void setMapping(Mapping _mapping) { m_mapping = _mapping; }
+    Mapping mapping() const { return m_mapping; }
+    void setBlendCount(size_t _k) { m_blendCount = std::max<size_t>(1, std::min(_k, MaxBlend)); }
+    size_t blendCount() const { return m_blendCount; }
+    void setParticleBounds(const std::vector<ngl::Vec3> &_points);  // particles are stretched from the box around
+                                                                    // _points, eg. the graph nodes, or their own box
+                                                                    // each call if _points is empty
+
+    // writes numVertices() colours to _out, vertex i gets _colors[i % size], chunks are shared over _pool if given
+    void colors(const std::vector<ngl::Vec3> &_colors, ngl::Vec3 *_out, ThreadPool *_pool = nullptr) const;
+    // as colors, but picks for each vertex by mapping(), _colors[i] belongs to the particle at _positions[i]
+    void mapColors(const std::vector<ngl::Vec3> &_positions, const std::vector<ngl::Vec3> &_colors,
+                   ngl::Vec3 *_out, ThreadPool *_pool = nullptr) const;
+
+private:
+    std::vector<ngl::Vec3> m_vertices;
+    std::vector<uint32_t> m_indices;
+    std::vector<ngl::Vec3> m_embedded;      // vertices stretched to the unit cube
+    size_t m_chunkSize = 65536;
+    Mapping m_mapping = Mapping::Repeat;
+    size_t m_blendCount = 4;
+    std::vector<ngl::Vec3> m_particleBounds;    // corners of the box set by setParticleBounds, or empty
+
+    void embed();                           // fills m_embedded
+};
+
+#endif
@@ -1,18 +1,34 @@
 #ifndef COLORTEAPOT_H_
 #define COLORTEAPOT_H_
 
+#include <cstdint>
+#include <string>
 #include <vector>
 #include <ngl/Vec3.h>
 
 class ColorTeapot
 {
 public:
-    ColorTeapot();
-    size_t numTris() const { return m_vertices.size(); }
-    std::vector<ngl::Vec3> render(std::vector<ngl::Vec3> _colors);
+    ColorTeapot();                                      // loads DefaultMesh, or the embedded teapot if built with
+                                                        // DAS_EMBED_TEAPOT and the file can't be read
+    ColorTeapot(const std::string &_path);              // loads any .dasm mesh, see MeshFile
+    bool load(const std::string &_path);                // replaces the mesh, returns false and leaves it empty on failure
+    bool loadEmbedded();                                // replaces the mesh with the teapot.h table, returns false
+                                                        // unless built with DAS_EMBED_TEAPOT
+    bool save(const std::string &_path) const;          // writes the mesh out as .dasm
+    static const char *DefaultMesh;                     // teapot.dasm in DAS_ASSET_DIR, or in ./assets without it
+
+    size_t numTris() const { return m_indices.size(); }    // returns number of triangle corners
+    const std::vector<ngl::Vec3>& vertices() const { return m_vertices; }   // returns unique positions
+    const std::vector<uint32_t>& indices() const { return m_indices; }      // returns three vertices per triangle
+    void colors(const std::vector<ngl::Vec3> &_colors,
+                std::vector<ngl::Vec3> &_out) const;            // fills _out with a colour per vertex from _colors
+    std::vector<ngl::Vec3> render(const std::vector<ngl::Vec3> &_colors) const;  // returns interleaved vertex, colour
+                                                                                 // for every corner
 private:
-    std::vector<ngl::Vec3> m_vertices;
-    std::vector<ngl::Vec3> m_normals;
+    std::vector<ngl::Vec3> m_vertices;  // welded, each position once
+    std::vector<ngl::Vec3> m_normals;   // normal of the first corner welded into each vertex
+    std::vector<uint32_t> m_indices;
 };
 
 #endif
@@ -0,0 +1,64 @@
+#ifndef DYNAMICKDTREE_H_
+#define DYNAMICKDTREE_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <ngl/Vec3.h>
+#include "KdTree.h"
+#include "ThreadPool.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class DynamicKdTree
+/// @brief points with ids that can be added one at a time, for nearest and exact position queries.
+/// Uses the logarithmic method: the points are split over static KdTrees, level j holding at most 2^j of them. An
+/// insert gathers the new point and every level below the first empty one into a single new tree there, like a
+/// carry in a binary counter, so a point is rebuilt at most log n times and an insert costs amortised O(log^2 n).
+/// Queries look in each of the O(log n) levels. Levels never change once built and are shared by copies, so a
+/// copy is a handful of pointers and an insert into it only builds the new level.
+/// Nothing is ever taken out: callers mark points dead themselves, hand queries a test to skip them and build a
+/// fresh index once too many are dead.
+//----------------------------------------------------------------------------------------------------------------------
+class DynamicKdTree
+{
+public:
+    typedef std::function<bool(size_t, const ngl::Vec3&)> Skip;    // given an id and position, true if a query
+                                                                    // should pass over it
+
+    DynamicKdTree()=default;
+    DynamicKdTree(const std::vector<ngl::Vec3> &_points, ThreadPool *_pool=nullptr);   // ids are the indices
+    DynamicKdTree(const std::vector<ngl::Vec3> &_points, const std::vector<size_t> &_ids,
+                  ThreadPool *_pool=nullptr);
+
+    size_t size() const { return m_size; }                  // returns number of points, skipped ones included
+    size_t numLevels() const;                               // returns number of trees the points are in
+    void insert(const ngl::Vec3 &_pos, size_t _id);
+    // writes the ids and squared distances of the _k closest points that aren't skipped, closest first, with ties
+    // going to the lower id. Returns how many were found, each id at most once
+    size_t nearest(const ngl::Vec3 &_pos, size_t _k, size_t *_ids, float *_dists, const Skip &_skip=nullptr) const;
+    // finds the lowest id sitting bit for bit at _pos, returns false if there isn't one
+    bool find(const ngl::Vec3 &_pos, size_t &_id, const Skip &_skip=nullptr) const;
+
+private:
+    // Private struct Level, one static tree
+    struct Level
+    {
+        std::vector<ngl::Vec3> points;
+        std::vector<size_t> ids;                            // id of each point
+        KdTree tree;                                        // gives indices into points
+        std::unordered_multimap<uint64_t, size_t> exact;    // indices into points by hash of the exact position
+
+        Level(std::vector<ngl::Vec3> _points, std::vector<size_t> _ids, ThreadPool *_pool);
+    };
+
+    // MEMBER VARIABLES
+    std::vector<std::shared_ptr<const Level>> m_levels;     // level j holds up to 2^j points, or is null
+    size_t m_size = 0;
+
+    // PRIVATE FUNCTIONS
+    static uint64_t positionKey(const ngl::Vec3 &_pos);
+};
+
+#endif
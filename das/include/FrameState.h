@@ -0,0 +1,24 @@
+#ifndef FRAMESTATE_H_
+#define FRAMESTATE_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <ngl/Vec3.h>
+#include "Graph.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @struct FrameState
+/// @brief everything the renderer needs from one simulation step, copied out so drawing never touches ParticleSim.
+/// The graph is shared rather than copied, a new one is only made when the simulation's graph changes.
+//----------------------------------------------------------------------------------------------------------------------
+struct FrameState
+{
+    uint64_t tick = 0;                      // ParticleSim::tick() when taken
+    double time = 0.0;                      // ParticleSim::time() when taken
+    size_t goal = 0;
+    std::vector<ngl::Vec3> positions;       // every live particle
+    std::shared_ptr<const Graph> graph;     // the graph the particles were on, never edited once published
+};
+
+#endif
@@ -1,52 +1,108 @@
 #ifndef GRAPH_H_
 #define GRAPH_H_
 
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <ngl/Vec3.h>
+#include "DynamicKdTree.h"
+#include "ThreadPool.h"
 
 
 
 class Graph
 {
 public:
+    // Public struct Edge, for keeping track of weights
+    struct Edge
+    {
+        size_t n; // neighbor id value
+        float w;  // weight of this edge
+
+        // Constructor
+        Edge(size_t _n, float _w) : n(_n), w(_w) {;}
+        // Operator ==
+        bool operator==(const Edge& _other) const { return this->n == _other.n;}
+    };
+    // Public struct EdgeRange, read only view of a node's edges straight out of the graph, no copying.
+    // Invalidated by anything that changes the graph
+    struct EdgeRange
+    {
+        const Edge *first;
+        const Edge *last;
+
+        const Edge* begin() const { return first; }
+        const Edge* end() const { return last; }
+        size_t size() const { return static_cast<size_t>(last - first); }
+        bool empty() const { return first == last; }
+        const Edge& operator[](size_t _i) const { return first[_i]; }
+    };
+    // Public struct LineRange, a run of lines in lineIndices()
+    struct LineRange
+    {
+        size_t first;   // first line, lines are two indices each
+        size_t count;   // number of lines
+
+        LineRange(size_t _first, size_t _count) : first(_first), count(_count) {;}
+    };
+
     Graph()=default;
-    Graph(std::vector<ngl::Vec3> _points, size_t _degree);
+    Graph(std::vector<ngl::Vec3> _points, size_t _degree,
+          const std::function<bool(float)> &_progress=nullptr);     // _progress is told the fraction done as the
+                                                                    // edges are found, ending with 1. Returning
+                                                                    // false stops early and leaves an empty graph
 
-    size_t size() const { return m_graph.size(); }          // returns number of nodes in graph
+    size_t size() const { return m_size; }                  // returns one past the highest node id, removed nodes
+                                                            // included
+    size_t numNodes() const { return m_size - m_free.size(); }  // returns number of nodes not removed
+    bool isNode(size_t _node) const
+            { return _node < m_size && !at(_node).removed; }   // returns true if the id is in use
     size_t degree() const { return m_degree; }              // returns minimum degree of graph
     ngl::Vec3 pos(const size_t _node) const
-            { return m_graph[_node].p; }                    // returns position of the input node
+            { return at(_node).p; }                         // returns position of the input node
     size_t node(const ngl::Vec3 _pos) const;                // returns node value given the input position
+    size_t nearestNode(const ngl::Vec3 _pos) const;         // returns the node closest to any position, such as a colour
+    std::vector<size_t> nearestNodes(const ngl::Vec3 _pos,
+                                     size_t _k) const;      // returns up to _k nodes closest to _pos, closest first
+    std::vector<size_t> nearestNodes(const std::vector<ngl::Vec3> &_pos,
+                                     ThreadPool *_pool=nullptr) const;  // returns nearestNode for each of _pos
     std::vector<size_t> edges(const size_t _node) const;    // returns edges connected to the input node
-    bool isEdge(size_t _n1, size_t _n2);                    // returns true if there is an edge between the input nodes
+    EdgeRange neighbours(const size_t _node) const;         // returns the input node's edges without copying them
+    bool isEdge(size_t _n1, size_t _n2) const;              // returns true if there is an edge between the input nodes
     std::vector<ngl::Vec3> render() const;                  // returns list of positions for GL_LINES
+    std::vector<ngl::Vec3> positions() const;               // returns position of every node, in node order
+    const std::vector<uint32_t>& lineIndices() const
+            { return m_lines->indices; }                    // returns node pairs for GL_LINES, each edge once
+    uint64_t revision() const { return m_revision; }        // changes on every edit, unique across graphs
+    uint64_t baseRevision() const { return m_baseRevision; }    // revision lineIndices() was laid out at, moved on
+                                                                // when nodes are added or the lines grow
+    std::vector<LineRange> linesChangedSince(uint64_t _revision) const; // returns runs of lines edited after _revision
+    size_t sharedBlocks(const Graph &_other) const;         // returns how many blocks of nodes both graphs still share
 
     void removeEdge(size_t _n1, size_t _n2);                // removes the edge between the two provided notes
+    void addEdge(size_t _n1, size_t _n2);                   // adds an edge between two nodes if there isn't one
+    size_t addNode(const ngl::Vec3 _pos);                   // adds a node joined to its degree() nearest nodes and
+                                                            // returns its id, reusing a removed node's id if any
+    size_t addNode(const ngl::Vec3 _pos, size_t _k);        // as addNode, joined to its _k nearest
+    void removeNode(size_t _node);                          // removes a node and its edges, other ids don't change
 
-    std::vector<ngl::Vec3> aStar(size_t _self, size_t _goal);   // runs astar algorithm between given indices
+    std::vector<ngl::Vec3> aStar(size_t _self, size_t _goal) const;   // runs astar algorithm between given indices
+    std::vector<size_t> aStarNodes(size_t _self, size_t _goal) const; // as aStar, but returns the node ids of the path
+    std::vector<size_t> shortestPathTree(size_t _goal) const;         // returns next node towards _goal from every node
 
 private:
-    // Private struct Edge, for keeping track of weights
-    struct Edge
-    {
-        size_t n; // neighbor id value
-        float w;  // weight of this edge
-
-        // Constructor
-        Edge(size_t _n, float _w) : n(_n), w(_w) {;}
-        // Operator ==
-        bool operator==(const Edge& _other) const { return this->n == _other.n;}
-    };
     // Private struct Node, for keeping track of pos and holding edges
     struct Node
     {
         ngl::Vec3 p; // position of node
         std::vector<Edge> es;      // edge set
+        bool removed = false;      // tombstone, the id is on the free list
 
         // Constructor
         Node(ngl::Vec3 _p) : p(_p) {;}
-        // Getter
-        std::vector<size_t> edgeId() const;
     };
     // Private struct ScoreSort, for sorting by fscore in the aStar priority queue
     struct ScoreSort
@@ -66,14 +122,41 @@ private:
         bool operator>=(const ScoreSort& _other) const { return (FCompare(this->fscore, _other.fscore) || (this->fscore > _other.fscore)); }
     };
 
+    // Private struct Lines, the GL_LINES layout of the edges
+    struct Lines
+    {
+        std::vector<uint32_t> indices;                      // one line per edge, removed edges collapse to a point
+        std::unordered_map<uint64_t, size_t> slot;          // line of each edge, keyed by its lower and higher node
+        std::vector<std::pair<uint64_t, size_t>> edits;     // revision and line of every edit since the base revision
+        std::vector<size_t> free;                           // collapsed lines an added edge can take over
+    };
+    // nodes are kept in blocks so a copy of the graph shares them, an edit only copies the blocks it touches
+    static constexpr size_t BlockShift = 6;
+    static constexpr size_t BlockSize = size_t(1) << BlockShift;
+    typedef std::vector<Node> Block;
+
     // MEMBER VARIABLES
-    std::vector<Node> m_graph;
+    std::vector<std::shared_ptr<Block>> m_blocks;           // BlockSize nodes each, shared with copies until edited
+    size_t m_size = 0;
     size_t m_degree = 3;
+    std::vector<size_t> m_free;                             // removed node ids, reused by addNode
+    DynamicKdTree m_index;                                  // node positions, removed or moved ones are skipped
+    std::shared_ptr<Lines> m_lines = std::make_shared<Lines>();    // shared with copies until edited
+    uint64_t m_revision = 0;
+    uint64_t m_baseRevision = 0;
 
     // PRIVATE FUNCTIONS
-    size_t find_index(std::vector<float> _list, float _item, std::vector<size_t> _eId) const;
-    float heuristic_cost_estimate(size_t _self, size_t _goal);
-    std::vector<ngl::Vec3> reconstructPath(std::vector<size_t> _cameFrom, size_t _current);
+    const Node& at(size_t _node) const { return (*m_blocks[_node >> BlockShift])[_node & (BlockSize - 1)]; }
+    Block& editBlock(size_t _block);    // copies the block first if another graph shares it
+    Node& editNode(size_t _node) { return editBlock(_node >> BlockShift)[_node & (BlockSize - 1)]; }
+    Lines& editLines();                 // copies the lines first if another graph shares them
+    DynamicKdTree::Skip skipDead() const;   // skips index entries of removed nodes or old positions of reused ids
+    void addLine(size_t _n1, size_t _n2);
+    static uint64_t edgeKey(size_t _n1, size_t _n2);
+    void layoutLines();
+    size_t find_index(const std::vector<float> &_list, float _item, size_t _node) const;
+    float heuristic_cost_estimate(size_t _self, size_t _goal) const;
+    std::vector<size_t> reconstructPath(const std::vector<size_t> &_cameFrom, size_t _current) const;
 };
 
 #endif
@@ -0,0 +1,53 @@
+#ifndef GRAPHBUILDER_H_
+#define GRAPHBUILDER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "Graph.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class GraphBuilder
+/// @brief builds graphs on a worker thread so whoever asked can carry on using the old one.
+/// A job is anything that makes a Graph, it is handed a function to report its progress through which returns false
+/// once the job should give up. Only the newest request matters: asking again while a build is running cancels that
+/// build at its next report and throws its graph away, and requests that were waiting are replaced. Both callbacks are
+/// called on the worker thread.
+//----------------------------------------------------------------------------------------------------------------------
+class GraphBuilder
+{
+public:
+    typedef std::function<bool(float)> Progress;    // returns false once the job is stale
+    typedef std::function<Graph(const Progress&)> Job;
+
+    GraphBuilder(std::function<void(float)> _onProgress,
+                 std::function<void(Graph)> _onReady);  // _onReady gets every finished graph that is still wanted
+    ~GraphBuilder();                                // abandons anything waiting, cancels a build in progress and
+                                                    // waits for it to notice
+    GraphBuilder(const GraphBuilder&)=delete;
+    GraphBuilder& operator=(const GraphBuilder&)=delete;
+
+    void build(Job _job);                           // queues _job in place of any earlier request
+    bool isBuilding() const;                        // true from build until the newest graph is handed over
+    void wait();                                    // blocks until isBuilding is false
+
+private:
+    // MEMBER VARIABLES
+    std::function<void(float)> m_onProgress;
+    std::function<void(Graph)> m_onReady;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;         // a job was queued or we're quitting
+    std::condition_variable m_idle;         // the newest request is done
+    Job m_pending;
+    uint64_t m_requested = 0;               // number of build calls
+    uint64_t m_finished = 0;                // request number of the last job to finish
+    bool m_quit = false;
+    std::thread m_worker;
+
+    // PRIVATE FUNCTIONS
+    void workerLoop();
+};
+
+#endif
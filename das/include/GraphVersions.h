@@ -0,0 +1,91 @@
+#ifndef GRAPHVERSIONS_H_
+#define GRAPHVERSIONS_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "Graph.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class GraphVersions
+/// @brief publishes numbered, read only versions of a Graph to any number of reader threads while editors change it.
+/// Readers never lock or touch a reference count: read() claims a slot, notes the epoch it started in and takes the
+/// current version, which stays valid until the Snapshot is dropped. An edit copies the newest version, which only
+/// copies its list of node blocks, changes the copy, so just the blocks it touches are duplicated, and swaps it in.
+/// The version it replaced is freed by a later edit once every reader that started before the swap has finished.
+/// Editors queue up on a mutex. All snapshots must be dropped before the GraphVersions is destroyed.
+//----------------------------------------------------------------------------------------------------------------------
+class GraphVersions
+{
+    struct Version;
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> epoch{0};     // epoch its reader started in, 0 when free
+    };
+
+public:
+    static constexpr size_t MaxReaders = 64;    // snapshots that can be held at once, more wait for one to go
+
+    // Public class Snapshot, one reader's hold on a version
+    class Snapshot
+    {
+    public:
+        Snapshot(Snapshot &&_other) : m_slot(_other.m_slot), m_version(_other.m_version) { _other.m_slot = nullptr; }
+        ~Snapshot();
+        Snapshot(const Snapshot&)=delete;
+        Snapshot& operator=(const Snapshot&)=delete;
+        Snapshot& operator=(Snapshot&&)=delete;
+
+        const Graph& operator*() const;
+        const Graph* operator->() const { return &**this; }
+        uint64_t version() const;                   // number of the version held
+
+    private:
+        friend class GraphVersions;
+        Snapshot(Slot *_slot, const Version *_version) : m_slot(_slot), m_version(_version) {;}
+
+        Slot *m_slot;
+        const Version *m_version;
+    };
+
+    GraphVersions(Graph _graph=Graph());            // _graph is version 0
+    ~GraphVersions();
+    GraphVersions(const GraphVersions&)=delete;
+    GraphVersions& operator=(const GraphVersions&)=delete;
+
+    Snapshot read() const;                          // holds the newest version, never locks
+    uint64_t version() const;                       // returns the newest version's number
+    uint64_t edit(const std::function<void(Graph&)> &_edit);   // changes a copy of the newest version and publishes
+                                                                // it, returns its number
+    uint64_t publish(Graph _graph);                 // replaces the graph outright, returns the new version's number
+    size_t retired() const;                         // returns old versions still waiting on readers
+    void reclaim();                                 // frees the old versions no reader can still be using
+
+private:
+    // Private struct Version, a published graph
+    struct Version
+    {
+        Graph graph;
+        uint64_t number;
+
+        Version(Graph _graph, uint64_t _number) : graph(std::move(_graph)), number(_number) {;}
+    };
+
+    // MEMBER VARIABLES
+    mutable std::array<Slot, MaxReaders> m_slots;
+    std::atomic<const Version*> m_current;
+    std::atomic<uint64_t> m_epoch{1};                   // moves on every publish
+    mutable std::mutex m_editMutex;                     // editors only, readers never take it
+    std::vector<std::pair<uint64_t, const Version*>> m_retired;    // old versions and the epoch they were
+                                                                    // replaced in
+
+    // PRIVATE FUNCTIONS
+    uint64_t swapIn(Graph _graph);                      // needs m_editMutex
+    void reclaimLocked();                               // needs m_editMutex
+};
+
+#endif
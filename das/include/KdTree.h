@@ -0,0 +1,53 @@
+#ifndef KDTREE_H_
+#define KDTREE_H_
+
+#include <cstdint>
+#include <vector>
+#include <ngl/Vec3.h>
+#include "ThreadPool.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class KdTree
+/// @brief static 3d tree over a set of points for nearest point queries in O(log n).
+/// The tree is implicit, each range of the point array is split at its median along its widest axis and the median
+/// point sits in the middle of the range, so there are no node allocations or child pointers to chase.
+/// Queries return the index the point had in the array the tree was built from.
+//----------------------------------------------------------------------------------------------------------------------
+class KdTree
+{
+public:
+    KdTree()=default;
+    KdTree(const std::vector<ngl::Vec3> &_points, ThreadPool *_pool=nullptr);  // subtrees are built in parallel
+                                                                                // over _pool if given
+
+    size_t size() const { return m_points.size(); }         // returns number of points in the tree
+    size_t nearest(const ngl::Vec3 &_pos) const;            // returns index of the point closest to _pos, size() if empty
+    std::vector<size_t> nearest(const std::vector<ngl::Vec3> &_pos,
+                                ThreadPool *_pool=nullptr) const;   // returns nearest() for each of _pos
+    // writes the ids and squared distances of the _k points closest to _pos, closest first, returns how many
+    // were found (fewer than _k only if the tree is smaller). Allocates nothing, so it can run per vertex
+    size_t nearest(const ngl::Vec3 &_pos, size_t _k, size_t *_ids, float *_dists) const;
+
+private:
+    // MEMBER VARIABLES
+    std::vector<ngl::Vec3> m_points;    // points in tree order
+    std::vector<size_t> m_ids;          // original index of each point in m_points
+    std::vector<uint8_t> m_axis;        // split axis of the range whose median is this point
+
+    /// a point and its original index, partitioned together while building
+    struct Entry
+    {
+        ngl::Vec3 pos;
+        size_t id;
+    };
+
+    // PRIVATE FUNCTIONS
+    void build(std::vector<Entry> &_entries, size_t _begin, size_t _end);
+    size_t split(std::vector<Entry> &_entries, size_t _begin, size_t _end);     // partitions one range, returns its
+                                                                                // median
+    void search(size_t _begin, size_t _end, const ngl::Vec3 &_pos, size_t &_best, float &_bestDist) const;
+    void search(size_t _begin, size_t _end, const ngl::Vec3 &_pos, size_t _k,
+                size_t *_ids, float *_dists, size_t &_found) const;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef MESHFILE_H_
+#define MESHFILE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ngl/Vec3.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class MeshFile
+/// @brief read only, memory mapped view of a .dasm binary mesh.
+/// A .dasm file is a 24 byte header followed by the arrays a draw call wants as they are, so opening one is a
+/// mmap and a few checks with nothing to parse or convert. Everything is little endian:
+///     char magic[4] "DASM", uint32 version (1), uint32 vertex count, uint32 index count, uint32 flags, uint32 0
+///     float positions[3 * vertex count]
+///     float normals[3 * vertex count]                 only if flags has HasNormals
+///     uint32 indices[index count]                     three per triangle
+//----------------------------------------------------------------------------------------------------------------------
+class MeshFile
+{
+public:
+    enum Flags : uint32_t
+    {
+        HasNormals = 1
+    };
+
+    MeshFile()=default;
+    MeshFile(const std::string &_path);
+    ~MeshFile();
+    MeshFile(const MeshFile&)=delete;
+    MeshFile& operator=(const MeshFile&)=delete;
+
+    bool open(const std::string &_path);    // maps a file, returns false if it can't or it isn't a valid mesh
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+
+    size_t numVertices() const { return m_numVertices; }
+    size_t numIndices() const { return m_numIndices; }
+    bool hasNormals() const { return m_normals != nullptr; }
+    const float* positions() const { return m_positions; }      // returns x,y,z of each vertex
+    const float* normals() const { return m_normals; }          // returns x,y,z of each vertex, or null
+    void positions(std::vector<ngl::Vec3> &_out) const;         // copies the positions out into _out
+    void normals(std::vector<ngl::Vec3> &_out) const;           // as above, _out is left empty without normals
+    const uint32_t* indices() const { return m_indices; }
+
+    // writes a mesh out in this format, _normals can be empty
+    static bool write(const std::string &_path, const std::vector<ngl::Vec3> &_vertices,
+                      const std::vector<ngl::Vec3> &_normals, const std::vector<uint32_t> &_indices);
+
+private:
+    // MEMBER VARIABLES
+    void *m_data = nullptr;     // the mapping
+    size_t m_size = 0;
+    size_t m_numVertices = 0;
+    size_t m_numIndices = 0;
+    const float *m_positions = nullptr;
+    const float *m_normals = nullptr;
+    const uint32_t *m_indices = nullptr;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef MESHLOADER_H_
+#define MESHLOADER_H_
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+#include <ngl/Vec3.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class MeshLoader
+/// @brief reads triangle meshes from OBJ, PLY (ascii or binary little endian) or .dasm files.
+/// Files are streamed a line or an element at a time straight into the vertex and index arrays, so loading never
+/// holds more than the finished mesh plus a line of text. Only positions and faces are read, polygons are split into
+/// triangle fans. Everything returns false and leaves the arrays empty if the file can't be read or is malformed.
+//----------------------------------------------------------------------------------------------------------------------
+class MeshLoader
+{
+public:
+    // picks the format from the file extension
+    static bool load(const std::string &_path, std::vector<ngl::Vec3> &_vertices, std::vector<uint32_t> &_indices);
+    static bool loadObj(std::istream &_in, std::vector<ngl::Vec3> &_vertices, std::vector<uint32_t> &_indices);
+    static bool loadPly(std::istream &_in, std::vector<ngl::Vec3> &_vertices, std::vector<uint32_t> &_indices);
+};
+
+#endif
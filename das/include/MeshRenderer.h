@@ -0,0 +1,49 @@
+#ifndef MESHRENDERER_H_
+#define MESHRENDERER_H_
+
+#include <cstdint>
+#include <vector>
+#include <ngl/Types.h>
+#include <ngl/Vec3.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class MeshRenderer
+/// @brief draws a triangle mesh whose shape is fixed but whose colours change every frame.
+/// Positions and triangle indices go into static buffers once. Colours are a palette of any length held in a texture
+/// buffer, and the vertex shader gives vertex i palette entry i % palette size, so a frame uploads just the palette,
+/// and nothing at all if it hasn't changed. Meshes too big for that pattern to mean anything can instead map a
+/// colour per vertex and fill it in place. Needs a current OpenGL context. Positions are attribute 0 and vertex
+/// colours attribute 1, see teapotVertex.glsl.
+//----------------------------------------------------------------------------------------------------------------------
+class MeshRenderer
+{
+public:
+    MeshRenderer()=default;
+    ~MeshRenderer();
+    MeshRenderer(const MeshRenderer&)=delete;
+    MeshRenderer& operator=(const MeshRenderer&)=delete;
+
+    void setMesh(const std::vector<ngl::Vec3> &_vertices,
+                 const std::vector<uint32_t> &_indices);        // uploads the mesh, three indices per triangle
+    void setColors(const std::vector<ngl::Vec3> &_colors);      // replaces the palette
+    size_t numColors() const { return m_numColors; }
+    ngl::Vec3* mapVertexColors(size_t _n);                      // switches to a colour per vertex, returns _n to
+                                                                // write or null on failure, unmap before drawing
+    void unmapVertexColors();
+    bool hasVertexColors() const { return m_hasVertexColors; }  // true once mapped, until setColors is called
+    void draw(GLuint _textureUnit) const;                       // draws with the palette bound to _textureUnit
+
+private:
+    // MEMBER VARIABLES
+    GLuint m_vao = 0;
+    GLuint m_vertexBuffer = 0;
+    GLuint m_indexBuffer = 0;
+    GLuint m_colorBuffer = 0;       // palette storage
+    GLuint m_colorTexture = 0;      // texture buffer view of m_colorBuffer
+    GLuint m_vertexColorBuffer = 0;
+    GLsizei m_numIndices = 0;
+    size_t m_numColors = 0;
+    bool m_hasVertexColors = false;
+};
+
+#endif
@@ -6,7 +6,15 @@
 #include <ngl/AbstractVAO.h>
 #include "WindowParams.h"
 #include "Graph.h"
+#include "ParticleSim.h"
+#include "FrameState.h"
+#include "TripleBuffer.h"
+#include "SimulationThread.h"
+#include "GraphBuilder.h"
+#include "ParticleRenderer.h"
 #include "ColorTeapot.h"
+#include "ColorMesh.h"
+#include "MeshRenderer.h"
 #include <QEvent>
 #include <QResizeEvent>
 #include <QOpenGLWidget>
@@ -63,6 +71,11 @@ public slots :
     void setGraphType(int _i);
     void setTeapotVisible(bool _isVisible);
     void setTeapotEffectToggle(bool _isOn);
+    void setTeapotColorMapping(int _i);
+
+signals:
+    void graphProgress(int _percent);       // percentage of the graph being built in the background, emitted from
+                                            // the builder thread
 
 private:
 
@@ -104,55 +117,44 @@ private:
     ngl::Mat4 m_view;
     /// projection matrix
     ngl::Mat4 m_project;
-    /// timerID, for starting/stopping timer
-    int m_timerId;
-
-    // add a QT timer event
-    void timerEvent(QTimerEvent *_event) override;
 
     /// VAOs
     std::unique_ptr<ngl::AbstractVAO> m_lineVAO;
-    std::unique_ptr<ngl::AbstractVAO> m_teapotVAO;
-    /// Graph
-    Graph m_graph;
-    /// teapot
+    uint64_t m_lineBase = 0;        // layout of the graph lines in m_lineVAO
+    uint64_t m_lineRevision = 0;    // graph revision m_lineVAO was last brought up to
+    size_t m_numLines = 0;          // node positions and edge index pairs, drawn with glDrawElements
+    /// teapot, positions stay on the GPU and only the particle colours are uploaded
     ColorTeapot m_teapot;
+    ColorMesh m_mesh;                       // what's drawn, the teapot or the file DAS_MESH names
+    bool m_meshFromFile = false;
+    MeshRenderer m_teapotRenderer;
+    bool m_teapotColorsFixed = false;       // the plain colour is already uploaded, nothing to send
     bool m_teapotVisible = false;
     bool m_teapotEffectOn = false;
 
+    /// brings m_lineVAO up to date with _graph, edits only touch the index buffer
+    void updateLineBuffer(const Graph &_graph);
+
     /// load matrix to shaders
     void loadMatrixToShader(const ngl::Mat4 &_tx, const ngl::Vec4 &_color);
     void loadMatrixToTeapotShader(const ngl::Mat4 &_tx);
 
-    /// private struct for the particle animation data
-    struct Particle
-    {
-        ngl::Vec3 pos;
-        ngl::Vec3 goal;
-        std::vector<ngl::Vec3> path;
-        ngl::Vec3 dir;
-        float speed;
-
-        // constructors
-        Particle(ngl::Vec3 _pos, ngl::Vec3 _goal, std::vector<ngl::Vec3> _path, ngl::Vec3 _dir, float _speed) :
-            pos(_pos), goal(_goal), path(_path), dir(_dir), speed(_speed) {;}
-        Particle(ngl::Vec3 _pos, ngl::Vec3 _goal, float _speed) : pos(_pos), goal(_goal), speed(_speed) {;}
-        Particle()=default;
-    };
-    /// store the particles
-    std::vector<Particle> m_particles;
+    /// particle simulation, owns the graph
+    ParticleSim m_sim;
+    /// frames from the simulation to paintGL, which only ever draws what was published here
+    TripleBuffer<FrameState> m_frames;
+    std::vector<ngl::Vec3> m_noColors;      // colours for the plain teapot
+    /// steps m_sim and fills m_frames, once it's started m_sim is only changed through it
+    std::unique_ptr<SimulationThread> m_simThread;
+    std::unique_ptr<ThreadPool> m_colorPool;
+    /// builds graphs off the GUI thread and hands them to m_simThread
+    std::unique_ptr<GraphBuilder> m_graphBuilder;
+    uint64_t m_boundsRevision = 0;      // graph revision m_mesh's particle bounds came from
+    /// starts building a graph of _points in the background, particles restart on it once it's ready
+    void setGraph(std::vector<ngl::Vec3> _points, size_t _degree);
     bool m_visParticles = false;
-    size_t m_numParticles = 10;
-    size_t m_goal = 0;
-    bool m_isGoalRandom = false;
-    /// particle handlers
-    void spawn();
-    void createParticle(size_t _goal);
-    void animateParticles();
-    void prune();
-    void resetParticles();
-    void resetParticleGoal();
-    void randomGoal();
+    /// draws all the particles at once
+    ParticleRenderer m_particleRenderer;
 
     /// graph construction methods
     void makeGraph_2Dgrid(ngl::Vec2 _bl, ngl::Vec2 _tr, size_t _h, size_t _w);
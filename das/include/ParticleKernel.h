@@ -0,0 +1,43 @@
+#ifndef PARTICLEKERNEL_H_
+#define PARTICLEKERNEL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ParticleKernel.h
+/// @brief step kernels that advance particles stored as separate arrays along their direction of travel.
+/// Each particle moves dir * speed * dt, if that carries it onto or past its target node it is snapped to the
+/// node and flagged as arrived. Vector versions are chosen at runtime from what the cpu supports and give
+/// bit identical results to the scalar loop.
+//----------------------------------------------------------------------------------------------------------------------
+
+/// pointers into the particle arrays a kernel works on, all arrays hold at least size entries
+struct ParticleStepData
+{
+    float *px, *py, *pz;                // position, updated in place
+    const float *dx, *dy, *dz;          // normalized direction of travel
+    const float *tx, *ty, *tz;          // position of the node being headed for
+    const float *speed;                 // units per second
+    uint8_t *arrived;                   // set to 1 if the particle reached its target this step, 0 otherwise
+    size_t size;                        // number of particles
+};
+
+/// instruction sets a kernel can be built for
+enum class SimdLevel
+{
+    Scalar,
+    AVX2,
+    AVX512
+};
+
+size_t advanceParticles(const ParticleStepData &_data, float _dt);      // runs the active kernel, returns arrivals
+size_t advanceParticles(const ParticleStepData &_data, float _dt, SimdLevel _level);  // runs a specific kernel
+
+SimdLevel detectSimdLevel();                    // returns the best level the cpu supports
+SimdLevel simdLevel();                          // returns the level advanceParticles currently uses
+void setSimdLevel(SimdLevel _level);            // overrides the level, clamped to what the cpu supports. Safe
+                                                // mid step, workers pick it up on their next chunk
+const char* simdLevelName(SimdLevel _level);    // returns a printable name for the level
+
+#endif
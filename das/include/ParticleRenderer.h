@@ -0,0 +1,53 @@
+#ifndef PARTICLERENDERER_H_
+#define PARTICLERENDERER_H_
+
+#include <cstdint>
+#include <vector>
+#include <ngl/Types.h>
+#include <ngl/Mat4.h>
+#include <ngl/Vec3.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class ParticleRenderer
+/// @brief draws every particle in one instanced draw call.
+/// Each frame the particle positions and colours are streamed into a single per-instance buffer and a small sphere
+/// mesh is drawn once per instance with glDrawElementsInstanced. Past a particle count threshold the particles are
+/// drawn as screen facing point sprites instead, one vertex each. Needs a current OpenGL context for everything but
+/// the constructor.
+//----------------------------------------------------------------------------------------------------------------------
+class ParticleRenderer
+{
+public:
+    ParticleRenderer()=default;
+    ~ParticleRenderer();
+    ParticleRenderer(const ParticleRenderer&)=delete;
+    ParticleRenderer& operator=(const ParticleRenderer&)=delete;
+
+    void init(float _radius);                               // builds the sphere mesh, buffers and shaders
+    void setSpriteThreshold(size_t _n) { m_spriteThreshold = _n; }  // draw sprites from this many particles on
+    size_t spriteThreshold() const { return m_spriteThreshold; }
+    bool usesSprites() const { return static_cast<size_t>(m_numInstances) >= m_spriteThreshold; }
+
+    // streams positions in, coloured by position or all _color
+    void update(const std::vector<ngl::Vec3> &_pos, bool _colorByPosition, const ngl::Vec3 &_color);
+    // draws the particles, _viewportHeight and _project size the sprites to match the spheres
+    void draw(const ngl::Mat4 &_MVP, const ngl::Mat4 &_project, int _viewportHeight) const;
+
+private:
+    // MEMBER VARIABLES
+    GLuint m_sphereVAO = 0;
+    GLuint m_spriteVAO = 0;
+    GLuint m_sphereBuffer = 0;      // sphere vertex positions
+    GLuint m_sphereIndices = 0;     // sphere triangles
+    GLuint m_instanceBuffer = 0;    // position then colour of each particle
+    GLsizei m_numSphereIndices = 0;
+    GLsizei m_numInstances = 0;
+    size_t m_spriteThreshold = 20000;
+    float m_radius = 0.03f;
+    std::vector<ngl::Vec3> m_instances;     // staging for the instance buffer, kept to avoid reallocating
+
+    // PRIVATE FUNCTIONS
+    void bindInstanceAttributes(GLuint _position, GLuint _color, GLuint _divisor) const;
+};
+
+#endif
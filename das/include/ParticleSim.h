@@ -0,0 +1,154 @@
+#ifndef PARTICLESIM_H_
+#define PARTICLESIM_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include <ngl/Vec3.h>
+#include "FrameState.h"
+#include "Graph.h"
+#include "Philox.h"
+#include "ThreadPool.h"
+#include "Timeline.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class ParticleSim
+/// @brief headless particle simulation, particles spawn on random graph nodes and follow A* paths to a shared goal.
+/// Does not need an OpenGL context so it can be driven by NGLScene, tests or command line tools alike.
+/// Particle updates and path searches can be spread over several threads, the result of a step never depends on
+/// the thread count since every particle is updated independently and all bookkeeping is done in index order.
+/// Random draws come from a counter based generator keyed by the seed and the particle id or tick, so a run is
+/// fully determined by its seed and can be replayed with setSeed.
+/// In Stepped mode every particle is advanced every step. In EventDriven mode each particle's arrival time at its
+/// next node is computed once and queued, a step only touches particles whose arrival falls inside it and positions
+/// are interpolated from the departure time when asked for.
+/// While recording, every particle trip is also stored in a Timeline so any moment of the run can be played back
+/// later without stepping. Recorded trips follow exact arrival times, so they match EventDriven mode exactly. Stepped
+/// mode only notices an arrival at the end of a step, so it falls up to another step behind at every node.
+//----------------------------------------------------------------------------------------------------------------------
+class ParticleSim
+{
+public:
+    /// how particles are advanced
+    enum class Mode
+    {
+        Stepped,
+        EventDriven
+    };
+
+    ParticleSim();
+    ParticleSim(Graph _graph);
+    ParticleSim(Graph _graph, uint64_t _seed);
+
+    void step(float _dt);                                   // advances the simulation by _dt seconds
+
+    void setGraph(Graph _graph);                            // replaces the graph and resets the particles
+    const Graph& graph() const { return m_graph; }          // returns the graph the particles travel on
+
+    void setNumParticles(size_t _n) { m_numParticles = _n; }    // sets the particle cap
+    size_t numParticles() const { return m_numParticles; }      // returns the particle cap
+    size_t size() const { return m_particles.size(); }          // returns number of live particles
+    void setSpeed(float _speed) { m_speed = _speed; }           // sets speed of newly spawned particles (units/sec)
+    float speed() const { return m_speed; }                     // returns speed of newly spawned particles
+    void setRandomGoal(bool _isRandom) { m_isGoalRandom = _isRandom; }
+    bool isGoalRandom() const { return m_isGoalRandom; }
+    void setSeed(uint64_t _seed);                               // restarts the run from tick 0 with a new seed
+    uint64_t seed() const { return m_rng.seed(); }              // returns the seed of this run
+    uint64_t tick() const { return m_tick; }                    // returns number of steps taken since the last reset
+    double time() const { return m_time; }                      // returns seconds simulated since the last reset
+    void setMode(Mode _mode);                                   // switches mode, particles carry on where they are
+    Mode mode() const { return m_mode; }
+    void setRecording(bool _isRecording);                       // starts/stops recording particle trips
+    bool isRecording() const { return m_isRecording; }
+    const Timeline& timeline() const { return m_timeline; }     // returns trips recorded since the last reset
+    void setNumThreads(size_t _n);                              // sets the number of threads a step uses
+    size_t numThreads() const { return m_pool ? m_pool->size() : 1; }
+    ThreadPool* pool() const { return m_pool.get(); }          // returns the step threads to share, or null if one
+
+    size_t goal() const { return m_goal; }                  // returns the node all particles are heading towards
+    void changeGoal();                                      // picks a new random goal, everyone heads for it
+                                                            // once they reach the node they're travelling to
+    void reset();                                           // removes all particles, picks a new goal and respawns
+
+    ngl::Vec3 position(size_t _i) const;                    // returns current position of particle _i
+    std::vector<ngl::Vec3> positions() const;               // returns current position of every live particle
+    void positions(std::vector<ngl::Vec3> &_out) const;     // as above, into _out to reuse its memory
+    void snapshot(FrameState &_frame);                      // copies out the state to draw, see FrameState
+
+private:
+    /// structure-of-arrays particle storage, index i of every array belongs to particle i
+    struct Particles
+    {
+        std::vector<float> px, py, pz;      // current position, position at departure time in EventDriven mode
+        std::vector<float> dx, dy, dz;      // normalized direction of travel
+        std::vector<float> tx, ty, tz;      // position of the node currently headed for
+        std::vector<float> speed;           // units per second
+        std::vector<size_t> next;           // id of the node currently headed for
+        std::vector<uint64_t> id;           // unique per run and ascending, keys the particle's random draws
+        std::vector<double> depart;         // EventDriven: time the particle left px
+        std::vector<double> arrive;         // EventDriven: time the particle reaches its target
+        std::vector<size_t> track;          // recording: the particle's current track in m_timeline
+
+        size_t size() const { return px.size(); }
+        void clear();
+        void reserve(size_t _n);
+        void push_back(uint64_t _id, ngl::Vec3 _pos, float _speed, size_t _next);
+        void move(size_t _from, size_t _to);    // overwrites particle _to with particle _from
+        void resize(size_t _n);
+    };
+
+    /// a particle reaching the node it is headed for
+    struct Event
+    {
+        double time;
+        uint64_t id;
+
+        Event(double _time, uint64_t _id) : time(_time), id(_id) {;}
+        // Operator overrides - earliest first in the priority queue, ties broken by id so order is deterministic
+        bool operator>(const Event& _other) const
+                { return time > _other.time || (time == _other.time && id > _other.id); }
+    };
+
+    // MEMBER VARIABLES
+    Graph m_graph;
+    Particles m_particles;
+    std::shared_ptr<const Graph> m_published;   // copy of m_graph handed out by snapshot, remade once it's edited
+    std::vector<size_t> m_towards;  // next hop towards m_goal from every node, shared by all particles
+    std::vector<size_t> m_starts;   // nodes other than m_goal that can reach it, where particles spawn
+    std::vector<uint8_t> m_arrived; // per particle arrival flags written by the step kernel
+    size_t m_numParticles = 10;
+    size_t m_goal = 0;
+    bool m_isGoalRandom = false;
+    float m_speed = 0.5f;
+    std::unique_ptr<ThreadPool> m_pool;
+    Philox m_rng;
+    uint64_t m_tick = 0;
+    uint64_t m_nextId = 0;          // id of the next particle to spawn
+    uint64_t m_goalDraws = 0;       // number of goals picked so far
+    double m_time = 0.0;
+    Mode m_mode = Mode::Stepped;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> m_events;
+    bool m_isRecording = false;
+    Timeline m_timeline;
+    std::unordered_map<uint64_t, size_t> m_spawnPaths;  // timeline path id for each (start, goal) node pair
+
+    // PRIVATE FUNCTIONS
+    void spawn();
+    size_t randomStart(uint64_t _id) const;
+    static uint64_t randomSeed();
+    void animateParticles(float _dt);
+    void prune();
+    void resetParticleGoal();
+    void randomGoal();
+    void setTarget(size_t _i);      // points particle _i at its next node
+    bool nextHop(size_t _i);        // moves particle _i's next node one hop on, false once it has finished
+    void parallelFor(size_t _n, size_t _grain, const std::function<void(size_t, size_t)> &_fn) const;
+    size_t processEvents();         // handles every arrival up to m_time, returns number of finished particles
+    void schedule(size_t _i);       // queues the arrival of particle _i, which leaves px at depart
+    size_t recordPath(size_t _i);   // adds the rest of particle _i's path, from where it is now, to the timeline
+};
+
+#endif
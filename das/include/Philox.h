@@ -0,0 +1,60 @@
+#ifndef PHILOX_H_
+#define PHILOX_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Philox.h
+/// @brief Philox4x32-10 counter based random number generator (Salmon et al, "Parallel Random Numbers: As Easy as
+/// 1, 2, 3"). There is no state, a draw is a pure function of a 64 bit key (the run's seed) and a 128 bit counter,
+/// so any thread can draw the numbers for any particle/tick in any order and still get the same results.
+//----------------------------------------------------------------------------------------------------------------------
+class Philox
+{
+public:
+    typedef std::array<uint32_t, 4> Counter;
+    typedef std::array<uint32_t, 4> Result;
+
+    Philox(uint64_t _seed) : m_seed(_seed) {;}
+    uint64_t seed() const { return m_seed; }
+
+    // returns four random words for the counter
+    Result operator()(Counter _ctr) const
+    {
+        uint32_t k0 = static_cast<uint32_t>(m_seed);
+        uint32_t k1 = static_cast<uint32_t>(m_seed >> 32);
+        for(int round = 0; round < 10; ++round)
+        {
+            uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * _ctr[0];
+            uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * _ctr[2];
+            _ctr = {{static_cast<uint32_t>(p1 >> 32) ^ _ctr[1] ^ k0, static_cast<uint32_t>(p1),
+                     static_cast<uint32_t>(p0 >> 32) ^ _ctr[3] ^ k1, static_cast<uint32_t>(p0)}};
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        return _ctr;
+    }
+
+    // returns the first random word for counter (_a, _b, _stream)
+    uint32_t word(uint64_t _a, uint32_t _stream, uint32_t _b=0) const
+    {
+        return (*this)({{static_cast<uint32_t>(_a), static_cast<uint32_t>(_a >> 32), _stream, _b}})[0];
+    }
+    // returns a float in [0, 1) for counter (_a, _b, _stream)
+    float uniform(uint64_t _a, uint32_t _stream, uint32_t _b=0) const
+    {
+        return static_cast<float>(word(_a, _stream, _b) >> 8) * (1.0f / 16777216.0f);
+    }
+    // returns an integer in [0, _n) for counter (_a, _b, _stream)
+    size_t index(size_t _n, uint64_t _a, uint32_t _stream, uint32_t _b=0) const
+    {
+        return static_cast<size_t>((static_cast<uint64_t>(word(_a, _stream, _b)) * _n) >> 32);
+    }
+
+private:
+    uint64_t m_seed;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef SIMULATIONTHREAD_H_
+#define SIMULATIONTHREAD_H_
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "FrameState.h"
+#include "ParticleSim.h"
+#include "TripleBuffer.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class SimulationThread
+/// @brief steps a ParticleSim on its own thread at a fixed rate and publishes every result for drawing.
+/// Real time is added to an accumulator and the simulation takes whole steps of 1 / tickRate seconds out of it, so
+/// a run steps the same whatever the wake up jitter. After a slow tick the missed steps are caught up, at most
+/// maxCatchUp in one go, anything past that is dropped rather than letting the simulation fall further behind.
+/// While running, the simulation belongs to this thread: anyone else changes it by posting a command, commands run
+/// in order between steps. While stopped, post runs the command straight away and publishes the result.
+/// post can be called from any thread, start and stop from one controlling thread, usually the GUI's.
+//----------------------------------------------------------------------------------------------------------------------
+class SimulationThread
+{
+public:
+    typedef std::function<void(ParticleSim&)> Command;
+    static constexpr size_t NumBuckets = 24;    // histogram bucket 0 counts ticks under a microsecond, bucket b
+                                                // ticks of [2^(b-1), 2^b) microseconds
+
+    SimulationThread(ParticleSim &_sim, TripleBuffer<FrameState> &_frames,
+                     std::function<void()> _onFrame = nullptr);     // _onFrame is called on this thread after each
+                                                                    // publish, eg. to ask the GUI for a redraw
+    ~SimulationThread();
+    SimulationThread(const SimulationThread&)=delete;
+    SimulationThread& operator=(const SimulationThread&)=delete;
+
+    void start();                                   // starts stepping, does nothing if already running
+    void stop();                                    // finishes the current tick and waits for the thread
+    bool isRunning() const { return m_running; }
+    void post(Command _command);                    // runs _command on the simulation between steps
+
+    void setTickRate(double _hz);                   // steps per simulated second, takes effect on the next tick
+    double tickRate() const { return m_tickRate; }
+    void setMaxCatchUp(size_t _n) { m_maxCatchUp = std::max<size_t>(_n, 1); }
+    size_t maxCatchUp() const { return m_maxCatchUp; }
+
+    // stats since construction
+    uint64_t ticks() const { return m_ticks; }              // returns number of steps taken
+    uint64_t caughtUp() const { return m_caughtUp; }        // returns steps taken late to catch up
+    uint64_t dropped() const { return m_dropped; }          // returns steps given up on
+    std::array<uint64_t, NumBuckets> histogram() const;     // returns tick durations, see NumBuckets
+
+private:
+    // MEMBER VARIABLES
+    ParticleSim &m_sim;
+    TripleBuffer<FrameState> &m_frames;
+    std::function<void()> m_onFrame;
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<double> m_tickRate{100.0};
+    std::atomic<size_t> m_maxCatchUp{5};
+    std::mutex m_mutex;                     // guards m_commands, m_stop, and the simulation while stopped
+    std::condition_variable m_wake;
+    std::vector<Command> m_commands;
+    bool m_stop = false;
+    std::atomic<uint64_t> m_ticks{0};
+    std::atomic<uint64_t> m_caughtUp{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::array<std::atomic<uint64_t>, NumBuckets> m_histogram;
+
+    // PRIVATE FUNCTIONS
+    void run();
+    void publish();
+    void runCommands(std::vector<Command> &_commands);
+};
+
+#endif
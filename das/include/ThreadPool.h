@@ -0,0 +1,62 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class ThreadPool
+/// @brief fixed set of worker threads for data parallel loops.
+/// parallelFor splits [0, n) into chunks and deals each thread a contiguous run of them. A thread works through
+/// its own run front to back and, once empty, steals chunks from the back of the other threads' runs, so uneven
+/// chunks still balance. The calling thread takes part and the call returns once every chunk is done.
+//----------------------------------------------------------------------------------------------------------------------
+class ThreadPool
+{
+public:
+    ThreadPool(size_t _numThreads);                 // _numThreads includes the calling thread
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&)=delete;
+    ThreadPool& operator=(const ThreadPool&)=delete;
+
+    size_t size() const { return m_workers.size() + 1; }    // returns number of threads including the caller
+
+    // runs _fn(begin, end) over [0, _n) in chunks of _grain, blocks until all chunks are done
+    void parallelFor(size_t _n, size_t _grain, const std::function<void(size_t, size_t)> &_fn);
+
+private:
+    // a thread's share of chunk ids, begin in the low 32 bits and end in the high 32 bits so that
+    // the owner (popping the front) and thieves (popping the back) can both claim with one CAS
+    struct ChunkRun
+    {
+        std::atomic<uint64_t> span{0};
+        char pad[56];   // keep runs on separate cache lines
+    };
+
+    std::vector<std::thread> m_workers;
+    std::unique_ptr<ChunkRun[]> m_runs;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_finished;
+    uint64_t m_generation = 0;
+    size_t m_working = 0;
+    bool m_quit = false;
+
+    // current job
+    const std::function<void(size_t, size_t)> *m_job = nullptr;
+    size_t m_n = 0;
+    size_t m_grain = 1;
+
+    void workerLoop(size_t _id);
+    void runChunks(size_t _id);
+    bool popFront(size_t _id, uint32_t &_chunk);
+    bool popBack(size_t _id, uint32_t &_chunk);
+};
+
+#endif
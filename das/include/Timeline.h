@@ -0,0 +1,67 @@
+#ifndef TIMELINE_H_
+#define TIMELINE_H_
+
+#include <vector>
+#include <ngl/Vec3.h>
+#include "ThreadPool.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class Timeline
+/// @brief time parameterised record of particle motion.
+/// A particle moving at constant speed along a piecewise linear path is stored as a track, just a path id, a start
+/// time and a speed, and its position at any time is a pure function of those. Positions can be evaluated for any
+/// time in any order, so playback can seek, run at any frame rate or evaluate frames in parallel.
+/// Tracks must be added in order of start time.
+//----------------------------------------------------------------------------------------------------------------------
+class Timeline
+{
+public:
+    Timeline()=default;
+
+    size_t addPath(const std::vector<ngl::Vec3> &_points);          // stores a path, returns its id
+    size_t addTrack(size_t _path, double _start, float _speed);     // adds a particle following _path, returns its id
+    void endTrack(size_t _track, double _time);                     // cuts a track short, it vanishes at _time
+    void clear();
+
+    size_t numPaths() const { return m_paths.size(); }
+    size_t numTracks() const { return m_tracks.size(); }
+    float pathLength(size_t _path) const;                           // returns arc length of a path
+    double duration() const { return m_duration; }                  // returns time the last track ends
+
+    bool isAlive(size_t _track, double _time) const                 // returns true if the track is visible at _time
+            { return m_tracks[_track].start <= _time && _time < m_tracks[_track].end; }
+    ngl::Vec3 evaluate(size_t _track, double _time) const;          // returns a track's position at _time
+    std::vector<size_t> tracksAt(double _time) const;               // returns ids of every track alive at _time
+    std::vector<ngl::Vec3> positionsAt(double _time, ThreadPool *_pool=nullptr) const;  // positions of those tracks
+
+private:
+    // Private struct Path, a run of m_points with the arc length at each of them
+    struct Path
+    {
+        size_t first;   // index of the first point in m_points
+        size_t count;   // number of points
+
+        Path(size_t _first, size_t _count) : first(_first), count(_count) {;}
+    };
+    // Private struct Track, one particle's trip along a path
+    struct Track
+    {
+        size_t path;    // path id
+        double start;   // time the particle is at the start of the path
+        double end;     // time the particle vanishes
+        float speed;    // units per second
+
+        Track(size_t _path, double _start, double _end, float _speed) :
+            path(_path), start(_start), end(_end), speed(_speed) {;}
+    };
+
+    // MEMBER VARIABLES
+    std::vector<Path> m_paths;
+    std::vector<ngl::Vec3> m_points;
+    std::vector<float> m_arcLength;     // arc length up to each point of m_points, from the start of its path
+    std::vector<Track> m_tracks;        // sorted by start time
+    double m_maxLifetime = 0.0;         // longest any track lasts, bounds how far back tracksAt searches
+    double m_duration = 0.0;
+};
+
+#endif
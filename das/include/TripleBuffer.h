@@ -0,0 +1,53 @@
+#ifndef TRIPLEBUFFER_H_
+#define TRIPLEBUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class TripleBuffer
+/// @brief lock free handoff of the latest value from one writer thread to one reader thread.
+/// There are three slots: the writer fills its back slot and publishes it, the reader takes the latest published
+/// slot as its front, and the third is the one in between. Publishing and taking are a single atomic exchange of
+/// the middle slot, so neither side ever waits for the other, the writer can publish faster than the reader looks
+/// (frames in between are dropped) and the reader keeps its front until something newer is published.
+/// Slots are reused, so a T holding vectors keeps its capacity from frame to frame.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer()=default;
+    TripleBuffer(const TripleBuffer&)=delete;
+    TripleBuffer& operator=(const TripleBuffer&)=delete;
+
+    // writer side
+    T& back() { return m_slots[m_back]; }           // returns the slot to fill, holds an old frame
+    void publish()                                  // makes back() the latest, the writer gets a free slot
+    {
+        m_back = m_middle.exchange(static_cast<uint8_t>(m_back | Fresh), std::memory_order_acq_rel) & Index;
+    }
+
+    // reader side
+    bool update()                                   // moves front() to the latest frame, false if nothing newer
+    {
+        if(!(m_middle.load(std::memory_order_relaxed) & Fresh))
+        {
+            return false;
+        }
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & Index;
+        return true;
+    }
+    const T& front() const { return m_slots[m_front]; }    // returns the latest frame as of the last update()
+
+private:
+    static constexpr uint8_t Index = 3;     // low bits of m_middle, the slot in between
+    static constexpr uint8_t Fresh = 4;     // set when the middle slot was published and not yet taken
+
+    T m_slots[3];
+    std::atomic<uint8_t> m_middle{1};
+    uint8_t m_back = 0;
+    uint8_t m_front = 2;
+};
+
+#endif
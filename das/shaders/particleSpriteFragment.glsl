@@ -0,0 +1,16 @@
+#version 410 core
+
+layout (location = 0) out vec4 fragColor;
+
+in vec3 vertColor;
+
+void main()
+{
+    // round off the square point
+    vec2 p = gl_PointCoord * 2.0 - 1.0;
+    if(dot(p, p) > 1.0)
+    {
+        discard;
+    }
+    fragColor = vec4(vertColor, 1.0);
+}
@@ -0,0 +1,17 @@
+#version 410 core
+
+layout (location = 0) in vec3 inPosition;
+layout (location = 1) in vec3 inColor;
+
+uniform mat4 MVP;
+uniform float spriteScale; // sphere radius * projection scale * viewport height
+
+out vec3 vertColor;
+
+void main()
+{
+    gl_Position = MVP * vec4(inPosition, 1.0);
+    // projected diameter of the sphere in pixels
+    gl_PointSize = max(spriteScale / gl_Position.w, 1.0);
+    vertColor = inColor;
+}
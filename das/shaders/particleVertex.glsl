@@ -0,0 +1,15 @@
+#version 410 core
+
+layout (location = 0) in vec3 inVertex;     // sphere mesh
+layout (location = 1) in vec3 inPosition;   // per particle
+layout (location = 2) in vec3 inColor;      // per particle
+
+uniform mat4 MVP;
+
+out vec3 vertColor;
+
+void main()
+{
+    gl_Position = MVP * vec4(inVertex + inPosition, 1.0);
+    vertColor = inColor;
+}
@@ -1,14 +1,18 @@
 #version 410 core
 
 layout (location = 0) in vec3 inVertex;
-layout (location = 1) in vec3 inColor;
+layout (location = 1) in vec3 inColor;  // only read with vertexColors set
 
 uniform mat4 MVP;
+uniform samplerBuffer particleColors;   // palette, repeated over the vertices. Drawn indexed, so gl_VertexID is
+                                        // the welded vertex and every corner sharing it gets the same colour
+uniform int numColors;
+uniform bool vertexColors;              // colours come per vertex from inColor instead of the palette
 
 out vec3 vertColor;
 
 void main()
 {
     gl_Position = MVP * vec4(inVertex, 1.0);
-    vertColor = inColor;
+    vertColor = vertexColors ? inColor : texelFetch(particleColors, gl_VertexID % numColors).rgb;
 }
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include "ColorMesh.h"
+#include "KdTree.h"
+#include "MeshLoader.h"
+
+namespace
+{
+    // box of a point set, stretched to the unit cube by (p - lo) * scale + offset. Flat axes map to the middle
+    struct Box
+    {
+        ngl::Vec3 lo;
+        ngl::Vec3 hi;
+        ngl::Vec3 scale;
+        ngl::Vec3 offset;
+
+        Box(const ngl::Vec3 &_lo, const ngl::Vec3 &_hi) : lo(_lo), hi(_hi)
+        {
+            auto extent = _hi - _lo;
+            for(size_t i = 0; i < 3; ++i)
+            {
+                bool flat = !(extent[i] > 1e-6f);
+                scale[i] = flat ? 0.0f : 1.0f / extent[i];
+                offset[i] = flat ? 0.5f : 0.0f;
+            }
+        }
+        static Box of(const std::vector<ngl::Vec3> &_points)
+        {
+            ngl::Vec3 lo = _points.empty() ? ngl::Vec3() : _points[0];
+            ngl::Vec3 hi = lo;
+            for(auto& p : _points)
+            {
+                lo.m_x = std::min(lo.m_x, p.m_x); hi.m_x = std::max(hi.m_x, p.m_x);
+                lo.m_y = std::min(lo.m_y, p.m_y); hi.m_y = std::max(hi.m_y, p.m_y);
+                lo.m_z = std::min(lo.m_z, p.m_z); hi.m_z = std::max(hi.m_z, p.m_z);
+            }
+            return Box(lo, hi);
+        }
+        ngl::Vec3 operator()(const ngl::Vec3 &_p) const
+        {
+            return ngl::Vec3((_p.m_x - lo.m_x) * scale.m_x + offset.m_x, (_p.m_y - lo.m_y) * scale.m_y + offset.m_y,
+                             (_p.m_z - lo.m_z) * scale.m_z + offset.m_z);
+        }
+    };
+}
+
+constexpr size_t ColorMesh::MaxBlend;
+
+ColorMesh::ColorMesh(const std::string &_path)
+{
+    load(_path);
+}
+
+bool ColorMesh::load(const std::string &_path)
+{
+    bool loaded = MeshLoader::load(_path, m_vertices, m_indices);
+    embed();
+    return loaded;
+}
+
+void ColorMesh::setMesh(const std::vector<ngl::Vec3> &_vertices, const std::vector<uint32_t> &_indices)
+{
+    m_vertices = _vertices;
+    m_indices = _indices;
+    embed();
+}
+
+void ColorMesh::setParticleBounds(const std::vector<ngl::Vec3> &_points)
+{
+    m_particleBounds.clear();
+    if(!_points.empty())
+    {
+        Box box = Box::of(_points);
+        m_particleBounds = {box.lo, box.hi};
+    }
+}
+
+void ColorMesh::embed()
+{
+    Box box = Box::of(m_vertices);
+    m_embedded.resize(m_vertices.size());
+    for(size_t i = 0; i < m_vertices.size(); ++i)
+    {
+        m_embedded[i] = box(m_vertices[i]);
+    }
+}
+
+void ColorMesh::colors(const std::vector<ngl::Vec3> &_colors, ngl::Vec3 *_out, ThreadPool *_pool) const
+{
+    if(_colors.empty() || m_vertices.empty())
+    {
+        return;
+    }
+    auto fill = [&](size_t _begin, size_t _end)
+    {
+        // one % per chunk, then walk the palette
+        for(size_t i = _begin, c = _begin % _colors.size(); i < _end; ++i)
+        {
+            _out[i] = _colors[c];
+            if(++c == _colors.size())
+            {
+                c = 0;
+            }
+        }
+    };
+    if(_pool)
+    {
+        _pool->parallelFor(m_vertices.size(), m_chunkSize, fill);
+    }
+    else
+    {
+        for(size_t begin = 0; begin < m_vertices.size(); begin += m_chunkSize)
+        {
+            fill(begin, std::min(begin + m_chunkSize, m_vertices.size()));
+        }
+    }
+}
+
+void ColorMesh::mapColors(const std::vector<ngl::Vec3> &_positions, const std::vector<ngl::Vec3> &_colors,
+                          ngl::Vec3 *_out, ThreadPool *_pool) const
+{
+    if(m_mapping == Mapping::Repeat || _positions.size() != _colors.size())
+    {
+        colors(_colors, _out, _pool);
+        return;
+    }
+    if(_colors.empty() || m_vertices.empty())
+    {
+        return;
+    }
+    // particles into the same unit cube as the mesh, then a tree over them
+    Box box = m_particleBounds.empty() ? Box::of(_positions) : Box(m_particleBounds[0], m_particleBounds[1]);
+    std::vector<ngl::Vec3> embedded(_positions.size());
+    for(size_t i = 0; i < _positions.size(); ++i)
+    {
+        embedded[i] = box(_positions[i]);
+    }
+    KdTree tree(embedded, _pool);
+    size_t k = (m_mapping == Mapping::Nearest) ? 1 : m_blendCount;
+    auto fill = [&](size_t _begin, size_t _end)
+    {
+        size_t ids[MaxBlend];
+        float dists[MaxBlend];
+        for(size_t i = _begin; i < _end; ++i)
+        {
+            auto found = tree.nearest(m_embedded[i], k, ids, dists);
+            if(found == 1)
+            {
+                _out[i] = _colors[ids[0]];
+                continue;
+            }
+            ngl::Vec3 sum(0.0f, 0.0f, 0.0f);
+            float total = 0.0f;
+            for(size_t j = 0; j < found; ++j)
+            {
+                // the small constant keeps a particle sitting on the vertex finite and all but the whole weight
+                float w = 1.0f / (dists[j] + 1e-6f);
+                sum += _colors[ids[j]] * w;
+                total += w;
+            }
+            _out[i] = sum / total;
+        }
+    };
+    if(_pool)
+    {
+        // a query is far more work than a copy, so smaller chunks balance better
+        _pool->parallelFor(m_vertices.size(), std::min<size_t>(m_chunkSize, 4096), fill);
+    }
+    else
+    {
+        fill(0, m_vertices.size());
+    }
+}
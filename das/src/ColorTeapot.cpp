@@ -1,10 +1,86 @@
 #include <ngl/NGLInit.h>
 #include <ngl/Util.h>
 
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
 #include "ColorTeapot.h"
+#include "MeshFile.h"
+#ifdef DAS_EMBED_TEAPOT
 #include "teapot.h"
+#endif
+
+// the .pro files point this at das/assets, so the teapot is found wherever the program is run from
+#ifndef DAS_ASSET_DIR
+#define DAS_ASSET_DIR "assets"
+#endif
+
+const char *ColorTeapot::DefaultMesh = DAS_ASSET_DIR "/teapot.dasm";
 
 ColorTeapot::ColorTeapot()
+{
+    if(load(DefaultMesh) || loadEmbedded())
+    {
+        return;
+    }
+    std::cerr<<"ColorTeapot: couldn't load "<<DefaultMesh<<"\n";
+}
+
+ColorTeapot::ColorTeapot(const std::string &_path)
+{
+    load(_path);
+}
+
+bool ColorTeapot::load(const std::string &_path)
+{
+    m_vertices.clear();
+    m_normals.clear();
+    m_indices.clear();
+    MeshFile file;
+    if(!file.open(_path))
+    {
+        return false;
+    }
+    // straight copies out of the mapping, nothing to parse
+    file.positions(m_vertices);
+    file.normals(m_normals);
+    m_indices.assign(file.indices(), file.indices() + file.numIndices());
+    return true;
+}
+
+bool ColorTeapot::save(const std::string &_path) const
+{
+    return MeshFile::write(_path, m_vertices, m_normals, m_indices);
+}
+
+#ifdef DAS_EMBED_TEAPOT
+namespace
+{
+    // exact bits of a position, adding 0 so -0 and 0 weld together
+    std::array<uint32_t, 3> positionBits(const ngl::Vec3 &_p)
+    {
+        float xyz[3] = {_p.m_x + 0.0f, _p.m_y + 0.0f, _p.m_z + 0.0f};
+        std::array<uint32_t, 3> bits;
+        std::memcpy(bits.data(), xyz, sizeof(xyz));
+        return bits;
+    }
+    struct PositionHash
+    {
+        size_t operator()(const std::array<uint32_t, 3> &_bits) const
+        {
+            uint64_t h = 0xcbf29ce484222325ull;
+            for(auto b : _bits)
+            {
+                h = (h ^ b) * 0x100000001b3ull;
+            }
+            return static_cast<size_t>(h ^ (h >> 32));
+        }
+    };
+}
+
+bool ColorTeapot::loadEmbedded()
 {
     // the ngl teapot is an array of size 128304
     // data is arranged in: tx,ty,nx,ny,nz,vx,vy,vz
@@ -13,30 +89,68 @@ ColorTeapot::ColorTeapot()
     size_t NUM_TRIS = 5346;
     size_t NUM_VERTS = NUM_TRIS * 3;
 
+    m_vertices.clear();
+    m_normals.clear();
+    m_indices.clear();
     m_vertices.reserve(NUM_VERTS);
     m_normals.reserve(NUM_VERTS);
+    m_indices.reserve(NUM_VERTS);
 
+    // weld corners at the same position into one vertex, in order of first use
+    std::unordered_map<std::array<uint32_t, 3>, uint32_t, PositionHash> welded;
+    welded.reserve(NUM_VERTS);
     for(size_t i = 0; i < NUM_VERTS; ++i)
     {
         auto ind = i * 8;
         // ind+0 is tx
         // ind+1 is ty
-        m_normals.push_back(ngl::Vec3(static_cast<float>(teapot[ind+2]),
-                                      static_cast<float>(teapot[ind+3]),
-                                      static_cast<float>(teapot[ind+4])));
-        m_vertices.push_back(ngl::Vec3(static_cast<float>(teapot[ind+5]),
-                                       static_cast<float>(teapot[ind+6]),
-                                       static_cast<float>(teapot[ind+7])));
+        ngl::Vec3 p(static_cast<float>(teapot[ind+5]),
+                    static_cast<float>(teapot[ind+6]),
+                    static_cast<float>(teapot[ind+7]));
+        auto found = welded.emplace(positionBits(p), static_cast<uint32_t>(m_vertices.size()));
+        if(found.second)
+        {
+            m_normals.push_back(ngl::Vec3(static_cast<float>(teapot[ind+2]),
+                                          static_cast<float>(teapot[ind+3]),
+                                          static_cast<float>(teapot[ind+4])));
+            m_vertices.push_back(p);
+        }
+        m_indices.push_back(found.first->second);
+    }
+    return true;
+}
+#else
+bool ColorTeapot::loadEmbedded()
+{
+    return false;
+}
+#endif
+
+void ColorTeapot::colors(const std::vector<ngl::Vec3> &_colors, std::vector<ngl::Vec3> &_out) const
+{
+    // same repeating assignment as render, without the vertices
+    _out.resize(m_vertices.size());
+    if(_colors.empty())
+    {
+        return;
+    }
+    for(size_t i = 0, c = 0; i < m_vertices.size(); ++i)
+    {
+        _out[i] = _colors[c];
+        if(++c == _colors.size())
+        {
+            c = 0;
+        }
     }
 }
 
-std::vector<ngl::Vec3> ColorTeapot::render(std::vector<ngl::Vec3> _colors)
+std::vector<ngl::Vec3> ColorTeapot::render(const std::vector<ngl::Vec3> &_colors) const
 {
-    // _colors can be of any size, just going to use % operator and repeat the colors
-    // return vector org: [vertex] [color]
+    // _colors can be of any size, just going to use % operator and repeat the colors over the vertices
+    // return vector org: [vertex] [color] for every triangle corner
     std::vector<ngl::Vec3> renderlist;
-    renderlist.reserve(m_vertices.size() * 2);
-    for(size_t i = 0; i < m_vertices.size(); ++i)
+    renderlist.reserve(m_indices.size() * 2);
+    for(auto i : m_indices)
     {
         renderlist.push_back(m_vertices[i]);
         renderlist.push_back(_colors[i % _colors.size()]);
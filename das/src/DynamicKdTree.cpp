@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstring>
+#include "DynamicKdTree.h"
+
+DynamicKdTree::Level::Level(std::vector<ngl::Vec3> _points, std::vector<size_t> _ids, ThreadPool *_pool) :
+    points(std::move(_points)), ids(std::move(_ids)), tree(points, _pool)
+{
+    exact.reserve(points.size());
+    for(size_t i = 0; i < points.size(); ++i)
+    {
+        exact.emplace(positionKey(points[i]), i);
+    }
+}
+
+DynamicKdTree::DynamicKdTree(const std::vector<ngl::Vec3> &_points, ThreadPool *_pool)
+{
+    std::vector<size_t> ids(_points.size());
+    for(size_t i = 0; i < ids.size(); ++i)
+    {
+        ids[i] = i;
+    }
+    *this = DynamicKdTree(_points, ids, _pool);
+}
+
+DynamicKdTree::DynamicKdTree(const std::vector<ngl::Vec3> &_points, const std::vector<size_t> &_ids,
+                             ThreadPool *_pool) :
+    m_size(_points.size())
+{
+    if(_points.empty())
+    {
+        return;
+    }
+    // everything in the first level big enough, the ones below fill up with inserts before it's rebuilt
+    size_t level = 0;
+    while((size_t(1) << level) < _points.size())
+    {
+        ++level;
+    }
+    m_levels.resize(level + 1);
+    m_levels[level] = std::make_shared<const Level>(_points, _ids, _pool);
+}
+
+size_t DynamicKdTree::numLevels() const
+{
+    return static_cast<size_t>(std::count_if(m_levels.begin(), m_levels.end(),
+                                             [](const std::shared_ptr<const Level> &_l) { return _l != nullptr; }));
+}
+
+void DynamicKdTree::insert(const ngl::Vec3 &_pos, size_t _id)
+{
+    std::vector<ngl::Vec3> points = {_pos};
+    std::vector<size_t> ids = {_id};
+    // carry every full level into the first empty one, levels 0..j-1 hold at most 2^j - 1 so it all fits
+    size_t j = 0;
+    for(; j < m_levels.size() && m_levels[j]; ++j)
+    {
+        points.insert(points.end(), m_levels[j]->points.begin(), m_levels[j]->points.end());
+        ids.insert(ids.end(), m_levels[j]->ids.begin(), m_levels[j]->ids.end());
+        m_levels[j] = nullptr;
+    }
+    if(j == m_levels.size())
+    {
+        m_levels.push_back(nullptr);
+    }
+    m_levels[j] = std::make_shared<const Level>(std::move(points), std::move(ids), nullptr);
+    ++m_size;
+}
+
+size_t DynamicKdTree::nearest(const ngl::Vec3 &_pos, size_t _k, size_t *_ids, float *_dists, const Skip &_skip) const
+{
+    size_t found = 0;
+    if(_k == 0)
+    {
+        return found;
+    }
+    std::vector<size_t> levelIds;
+    std::vector<float> levelDists;
+    for(auto& level : m_levels)
+    {
+        if(!level)
+        {
+            continue;
+        }
+        // ask for more until _k of them aren't skipped, the level runs out, or the rest can't beat what we have
+        size_t want = _k;
+        size_t got = 0;
+        for(;;)
+        {
+            levelIds.resize(want);
+            levelDists.resize(want);
+            got = level->tree.nearest(_pos, want, levelIds.data(), levelDists.data());
+            size_t live = 0;
+            for(size_t i = 0; i < got; ++i)
+            {
+                auto p = levelIds[i];
+                live += (_skip && _skip(level->ids[p], level->points[p])) ? 0 : 1;
+            }
+            if(live >= _k || got < want || (found == _k && levelDists[got - 1] > _dists[found - 1]))
+            {
+                break;
+            }
+            want *= 2;
+        }
+        // merge into the sorted best list, same tie break as KdTree
+        for(size_t i = 0; i < got; ++i)
+        {
+            auto p = levelIds[i];
+            auto id = level->ids[p];
+            auto dist = levelDists[i];
+            if((_skip && _skip(id, level->points[p])) || std::find(_ids, _ids + found, id) != _ids + found)
+            {
+                continue;
+            }
+            auto closer = [&](size_t _slot) { return dist < _dists[_slot] || (dist == _dists[_slot] && id < _ids[_slot]); };
+            if(found == _k && !closer(found - 1))
+            {
+                continue;
+            }
+            size_t slot = (found < _k) ? found++ : _k - 1;
+            while(slot > 0 && closer(slot - 1))
+            {
+                _ids[slot] = _ids[slot - 1];
+                _dists[slot] = _dists[slot - 1];
+                --slot;
+            }
+            _ids[slot] = id;
+            _dists[slot] = dist;
+        }
+    }
+    return found;
+}
+
+bool DynamicKdTree::find(const ngl::Vec3 &_pos, size_t &_id, const Skip &_skip) const
+{
+    bool found = false;
+    for(auto& level : m_levels)
+    {
+        if(!level)
+        {
+            continue;
+        }
+        auto range = level->exact.equal_range(positionKey(_pos));
+        for(auto it = range.first; it != range.second; ++it)
+        {
+            auto& p = level->points[it->second];
+            auto id = level->ids[it->second];
+            if(p.m_x == _pos.m_x && p.m_y == _pos.m_y && p.m_z == _pos.m_z && (!found || id < _id) &&
+               !(_skip && _skip(id, p)))
+            {
+                _id = id;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+uint64_t DynamicKdTree::positionKey(const ngl::Vec3 &_pos)
+{
+    // mix the bits of the three floats, adding 0 first so -0 and 0 hash the same
+    float xyz[3] = {_pos.m_x + 0.0f, _pos.m_y + 0.0f, _pos.m_z + 0.0f};
+    uint32_t bits[3];
+    std::memcpy(bits, xyz, sizeof(bits));
+    uint64_t key = 0xcbf29ce484222325ull;
+    for(auto b : bits)
+    {
+        key = (key ^ b) * 0x100000001b3ull;
+        key ^= key >> 29;
+    }
+    return key;
+}
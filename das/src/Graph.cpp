@@ -1,22 +1,47 @@
 #include <utility>
 #include <algorithm>
+#include <atomic>
 #include <queue>
 #include <iostream>
+#include <limits>
 #include <ngl/Vec3.h>
 #include "Graph.h"
 
-Graph::Graph(std::vector<ngl::Vec3> _points, size_t _degree) : m_degree(_degree)
+namespace
+{
+    // hands out revisions, shared by every graph so a new graph never matches an old one's revision
+    std::atomic<uint64_t> s_revisions{0};
+}
+
+constexpr size_t Graph::BlockShift;
+constexpr size_t Graph::BlockSize;
+
+Graph::Graph(std::vector<ngl::Vec3> _points, size_t _degree, const std::function<bool(float)> &_progress) :
+    m_size(_points.size()),
+    m_degree(_degree)
 {
     // allocate graph
-    m_graph.reserve(_points.size());
-    for(auto point : _points)
+    m_blocks.reserve((_points.size() + BlockSize - 1) / BlockSize);
+    for(size_t n = 0; n < _points.size(); ++n)
     {
-        Node n(point);
-        m_graph.push_back(n);
+        if(n % BlockSize == 0)
+        {
+            m_blocks.push_back(std::make_shared<Block>());
+            m_blocks.back()->reserve(std::min(BlockSize, _points.size() - n));
+        }
+        m_blocks.back()->push_back(Node(_points[n]));
     }
-    // add edges
-    for(size_t n = 0; n < m_graph.size(); ++n)
+    m_index = DynamicKdTree(_points);
+    // add edges, this is nearly all the work so progress is counted here
+    size_t reportEvery = std::max<size_t>(m_size / 100, 1);
+    for(size_t n = 0; n < m_size; ++n)
     {
+        if(_progress && n % reportEvery == 0 && !_progress(static_cast<float>(n) / static_cast<float>(m_size)))
+        {
+            // whoever asked doesn't want it any more, don't hand back a half linked graph
+            *this = Graph();
+            return;
+        }
         std::vector<float> weights;
         weights.reserve(_points.size());
         // calc and store distance between self and every other node
@@ -33,65 +58,127 @@ Graph::Graph(std::vector<ngl::Vec3> _points, size_t _degree) : m_degree(_degree)
         while((edges_stored < m_degree) && (index < sorted_weights.size()))
         {
             // protect against out of index
-            auto edgeNode = find_index(weights, sorted_weights[index], m_graph[n].edgeId());
-            if((edgeNode != m_graph.size()) && (edgeNode != n))
+            auto edgeNode = find_index(weights, sorted_weights[index], n);
+            if((edgeNode != m_size) && (edgeNode != n))
             {
                 Edge e(edgeNode, sorted_weights[index]);
-                m_graph[n].es.push_back(e);
+                editNode(n).es.push_back(e);
                 ++edges_stored;
             }
             ++index;
         }
     }
     // now add reverse edges to make sure we're all bidirectional in this graph
-    for(size_t n = 0; n < m_graph.size(); ++n)
+    for(size_t n = 0; n < m_size; ++n)
     {
         // loop through neighbor list and make sure we're in their neighbor list
-        for(auto e : m_graph[n].es)
+        for(auto e : at(n).es)
         {
-            // grab edgeID list
-            auto nEdges = m_graph[e.n].edgeId();
             // add ourselves if we're not there
-            if(std::find(nEdges.begin(), nEdges.end(), n) == nEdges.end())
+            if(!isEdge(e.n, n))
             {
                 Edge newEdge(n, (_points[n] - _points[e.n]).lengthSquared());
-                m_graph[e.n].es.push_back(newEdge);
+                editNode(e.n).es.push_back(newEdge);
             }
         }
     }
+    layoutLines();
+    if(_progress)
+    {
+        _progress(1.0f);
+    }
 }
 
 size_t Graph::node(const ngl::Vec3 _pos) const
 {
-    for(size_t i = 0; i < m_graph.size(); ++i)
+    // bit for bit the same position, the usual case as positions come from pos()
+    size_t found;
+    auto skip = skipDead();
+    if(m_index.find(_pos, found, skip))
+    {
+        return found;
+    }
+    // otherwise it's a match if the nearest node is within Vec3 tolerance
+    auto nearest = nearestNode(_pos);
+    if(nearest != m_size && _pos == at(nearest).p)
     {
-        if(_pos == m_graph[i].p)
+        return nearest;
+    }
+    return m_size; //returns out of index if not found
+}
+
+size_t Graph::nearestNode(const ngl::Vec3 _pos) const
+{
+    size_t id;
+    float dist;
+    return (m_index.nearest(_pos, 1, &id, &dist, skipDead()) == 1) ? id : m_size;
+}
+
+std::vector<size_t> Graph::nearestNodes(const ngl::Vec3 _pos, size_t _k) const
+{
+    std::vector<size_t> ids(_k);
+    std::vector<float> dists(_k);
+    ids.resize(m_index.nearest(_pos, _k, ids.data(), dists.data(), skipDead()));
+    return ids;
+}
+
+std::vector<size_t> Graph::nearestNodes(const std::vector<ngl::Vec3> &_pos, ThreadPool *_pool) const
+{
+    std::vector<size_t> ids(_pos.size());
+    auto skip = skipDead();
+    auto query = [&](size_t _begin, size_t _end)
+    {
+        for(size_t i = _begin; i < _end; ++i)
         {
-            return i;
+            float dist;
+            if(m_index.nearest(_pos[i], 1, &ids[i], &dist, skip) == 0)
+            {
+                ids[i] = m_size;
+            }
         }
+    };
+    if(_pool)
+    {
+        _pool->parallelFor(_pos.size(), 1024, query);
+    }
+    else
+    {
+        query(0, _pos.size());
     }
-    return m_graph.size(); //returns out of index if not found
+    return ids;
 }
 
 std::vector<size_t> Graph::edges(const size_t _node) const
 {
     std::vector<size_t> edg;
-    if(_node < m_graph.size())
+    for(auto& e : neighbours(_node))
     {
-        edg = m_graph[_node].edgeId();
+        edg.push_back(e.n);
     }
     return edg;
 }
 
-bool Graph::isEdge(size_t _n1, size_t _n2)
+Graph::EdgeRange Graph::neighbours(const size_t _node) const
+{
+    if(_node >= m_size)
+    {
+        return EdgeRange{nullptr, nullptr};
+    }
+    auto& es = at(_node).es;
+    return EdgeRange{es.data(), es.data() + es.size()};
+}
+
+bool Graph::isEdge(size_t _n1, size_t _n2) const
 {
     // Assumes bidirectional completeness - doesn't check n2's edges
-    if(_n1 < m_graph.size() && _n2 < m_graph.size())
+    if(_n2 < m_size)
     {
-        Edge en2(_n2, 0.0f);
-        if(std::find(m_graph[_n1].es.begin(), m_graph[_n1].es.end(), en2) != m_graph[_n1].es.end())
+        for(auto& e : neighbours(_n1))
         {
-            return true;
+            if(e.n == _n2)
+            {
+                return true;
+            }
         }
     }
     return false;
@@ -102,12 +189,12 @@ std::vector<ngl::Vec3> Graph::render() const
     std::vector<ngl::Vec3> lines;
     // Loop through and dump everything
     // For now, we're not going to try to avoid bidirectional duplicates
-    for(size_t n = 0; n < m_graph.size(); ++n)
+    for(size_t n = 0; n < m_size; ++n)
     {
-        for(auto e : m_graph[n].es)
+        for(auto& e : neighbours(n))
         {
-            lines.push_back(m_graph[n].p);
-            lines.push_back(m_graph[e.n].p);
+            lines.push_back(at(n).p);
+            lines.push_back(at(e.n).p);
         }
     }
     return lines;
@@ -119,26 +206,196 @@ void Graph::removeEdge(size_t _n1, size_t _n2)
     {
         // Go through _n1's edge list and remove _n2
         Edge en2(_n2, 0.0f);
-        auto posn2 = std::find(m_graph[_n1].es.begin(), m_graph[_n1].es.end(), en2);
-        m_graph[_n1].es.erase(posn2);
+        auto& es1 = editNode(_n1).es;
+        es1.erase(std::find(es1.begin(), es1.end(), en2));
         // Go through _n2's edge list and remove _n1
         Edge en1(_n1, 0.0f);
-        auto posn1 = std::find(m_graph[_n2].es.begin(), m_graph[_n2].es.end(), en1);
-        m_graph[_n2].es.erase(posn1);
+        auto& es2 = editNode(_n2).es;
+        es2.erase(std::find(es2.begin(), es2.end(), en1));
+        // collapse its line rather than shuffling the others down, so only that line needs uploading
+        auto& lines = editLines();
+        auto slot = lines.slot.find(edgeKey(_n1, _n2));
+        if(slot != lines.slot.end())
+        {
+            lines.indices[slot->second * 2 + 1] = lines.indices[slot->second * 2];
+            m_revision = ++s_revisions;
+            lines.edits.emplace_back(m_revision, slot->second);
+            lines.free.push_back(slot->second);
+            lines.slot.erase(slot);
+        }
+    }
+}
+
+void Graph::addEdge(size_t _n1, size_t _n2)
+{
+    if(_n1 == _n2 || !isNode(_n1) || !isNode(_n2) || isEdge(_n1, _n2))
+    {
+        return;
     }
+    // weighted like the edges the graph was built with
+    auto w = (at(_n1).p - at(_n2).p).lengthSquared();
+    editNode(_n1).es.push_back(Edge(_n2, w));
+    editNode(_n2).es.push_back(Edge(_n1, w));
+    addLine(_n1, _n2);
 }
 
-std::vector<ngl::Vec3> Graph::aStar(size_t _self, size_t _goal)
+size_t Graph::addNode(const ngl::Vec3 _pos)
+{
+    return addNode(_pos, m_degree);
+}
+
+size_t Graph::addNode(const ngl::Vec3 _pos, size_t _k)
+{
+    // neighbours first, so the new node can't find itself
+    auto closest = nearestNodes(_pos, _k);
+    size_t id;
+    if(!m_free.empty())
+    {
+        id = m_free.back();
+        m_free.pop_back();
+        auto& n = editNode(id);
+        n.p = _pos;
+        n.removed = false;
+    }
+    else
+    {
+        id = m_size++;
+        if((id >> BlockShift) == m_blocks.size())
+        {
+            m_blocks.push_back(std::make_shared<Block>());
+            m_blocks.back()->reserve(BlockSize);
+        }
+        editBlock(id >> BlockShift).push_back(Node(_pos));
+    }
+    // a reused id keeps its old index entry too, skipDead tells them apart by position
+    m_index.insert(_pos, id);
+    // the renderer has a new position to upload, moving the base revision on has it start again, so the edits
+    // made before now are never asked for
+    m_revision = ++s_revisions;
+    m_baseRevision = m_revision;
+    if(!m_lines->edits.empty())
+    {
+        editLines().edits.clear();
+    }
+    for(auto n : closest)
+    {
+        addEdge(id, n);
+    }
+    return id;
+}
+
+void Graph::removeNode(size_t _node)
+{
+    if(!isNode(_node))
+    {
+        return;
+    }
+    // copied, removeEdge changes the list as we go
+    auto es = at(_node).es;
+    for(auto& e : es)
+    {
+        removeEdge(_node, e.n);
+    }
+    editNode(_node).removed = true;
+    m_free.push_back(_node);
+    m_revision = ++s_revisions;
+    // once most of the index is dead, start a new one with just the live nodes
+    if(m_index.size() > 2 * numNodes())
+    {
+        std::vector<ngl::Vec3> points;
+        std::vector<size_t> ids;
+        points.reserve(numNodes());
+        ids.reserve(numNodes());
+        for(size_t n = 0; n < m_size; ++n)
+        {
+            if(isNode(n))
+            {
+                points.push_back(at(n).p);
+                ids.push_back(n);
+            }
+        }
+        m_index = DynamicKdTree(points, ids);
+    }
+}
+
+std::vector<ngl::Vec3> Graph::positions() const
+{
+    std::vector<ngl::Vec3> pos;
+    pos.reserve(m_size);
+    for(auto& b : m_blocks)
+    {
+        for(auto& n : *b)
+        {
+            pos.push_back(n.p);
+        }
+    }
+    return pos;
+}
+
+std::vector<Graph::LineRange> Graph::linesChangedSince(uint64_t _revision) const
+{
+    std::vector<size_t> edited;
+    // edits are in revision order, only look at the newer ones
+    auto& edits = m_lines->edits;
+    auto newer = std::upper_bound(edits.begin(), edits.end(), _revision,
+                                  [](uint64_t _r, const std::pair<uint64_t, size_t> &_e) { return _r < _e.first; });
+    for(auto it = newer; it != edits.end(); ++it)
+    {
+        edited.push_back(it->second);
+    }
+    std::sort(edited.begin(), edited.end());
+    // merge neighbouring lines into runs
+    std::vector<LineRange> runs;
+    for(auto l : edited)
+    {
+        if(!runs.empty() && l <= runs.back().first + runs.back().count)
+        {
+            runs.back().count = l + 1 - runs.back().first;
+        }
+        else
+        {
+            runs.push_back(LineRange(l, 1));
+        }
+    }
+    return runs;
+}
+
+size_t Graph::sharedBlocks(const Graph &_other) const
+{
+    size_t shared = 0;
+    for(size_t b = 0; b < std::min(m_blocks.size(), _other.m_blocks.size()); ++b)
+    {
+        if(m_blocks[b] == _other.m_blocks[b])
+        {
+            ++shared;
+        }
+    }
+    return shared;
+}
+
+std::vector<ngl::Vec3> Graph::aStar(size_t _self, size_t _goal) const
+{
+    std::vector<ngl::Vec3> path;
+    auto nodes = aStarNodes(_self, _goal);
+    path.reserve(nodes.size());
+    for(auto n : nodes)
+    {
+        path.push_back(at(n).p);
+    }
+    return path;
+}
+
+std::vector<size_t> Graph::aStarNodes(size_t _self, size_t _goal) const
 {
     float initVal = 1000.0f;
     // node you came from, currently most effective
-    std::vector<size_t> cameFrom(m_graph.size(), m_graph.size());
+    std::vector<size_t> cameFrom(m_size, m_size);
     cameFrom[_self] = _self;
     // gscore - for each node, cost of getting from start to the node
-    std::vector<float> gscore(m_graph.size(), initVal);
+    std::vector<float> gscore(m_size, initVal);
     gscore[_self] = 0.0f;
     // fscore - cost of getting from start to goal through this node
-    std::vector<float> fscore(m_graph.size(), initVal);
+    std::vector<float> fscore(m_size, initVal);
     fscore[_self] = heuristic_cost_estimate(_self, _goal);
     // open priority queue for processing nodes
     std::priority_queue<ScoreSort, std::vector<ScoreSort>, std::greater<ScoreSort>> open;
@@ -163,7 +420,7 @@ std::vector<ngl::Vec3> Graph::aStar(size_t _self, size_t _goal)
         }
 
         // loop through current's neighbors and add to open
-        for(auto e : m_graph[current.n].es)
+        for(auto& e : neighbours(current.n))
         {
             // tentative distance measurement between us and neighbor
             auto temp_gscore = gscore[current.n] + e.w;
@@ -189,14 +446,144 @@ std::vector<ngl::Vec3> Graph::aStar(size_t _self, size_t _goal)
     return reconstructPath(cameFrom, _goal);
 }
 
-size_t Graph::find_index(std::vector<float> _list, float _item, std::vector<size_t> _eId) const
+std::vector<size_t> Graph::shortestPathTree(size_t _goal) const
+{
+    // edges go both ways with the same weight, so searching out from the goal finds the best first
+    // step towards it for every node at once. Unreachable nodes are left at size()
+    std::vector<size_t> next(m_size, m_size);
+    if(_goal >= m_size)
+    {
+        return next;
+    }
+    std::vector<float> gscore(m_size, std::numeric_limits<float>::max());
+    next[_goal] = _goal;
+    gscore[_goal] = 0.0f;
+    std::priority_queue<ScoreSort, std::vector<ScoreSort>, std::greater<ScoreSort>> open;
+    open.push(ScoreSort(_goal, 0.0f));
+
+    while(!open.empty())
+    {
+        auto current = open.top();
+        open.pop();
+        // stale entry, this node has already been settled with a better score
+        if(current.fscore > gscore[current.n])
+        {
+            continue;
+        }
+        for(auto& e : neighbours(current.n))
+        {
+            auto temp_gscore = gscore[current.n] + e.w;
+            if(temp_gscore >= gscore[e.n])
+            {
+                continue;
+            }
+            // best way home from our neighbour is through us
+            next[e.n] = current.n;
+            gscore[e.n] = temp_gscore;
+            open.push(ScoreSort(e.n, temp_gscore));
+        }
+    }
+    return next;
+}
+
+uint64_t Graph::edgeKey(size_t _n1, size_t _n2)
+{
+    return (static_cast<uint64_t>(std::min(_n1, _n2)) << 32) | static_cast<uint64_t>(std::max(_n1, _n2));
+}
+
+Graph::Block& Graph::editBlock(size_t _block)
+{
+    auto& block = m_blocks[_block];
+    // nobody else can take a new reference to our blocks while we're editing, so one owner means it's ours
+    if(block.use_count() > 1)
+    {
+        block = std::make_shared<Block>(*block);
+    }
+    else
+    {
+        // pairs with whoever dropped the last other reference, so their reads are done before we write
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *block;
+}
+
+Graph::Lines& Graph::editLines()
+{
+    if(m_lines.use_count() > 1)
+    {
+        m_lines = std::make_shared<Lines>(*m_lines);
+    }
+    else
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *m_lines;
+}
+
+DynamicKdTree::Skip Graph::skipDead() const
+{
+    return [this](size_t _id, const ngl::Vec3 &_pos)
+    {
+        auto& n = at(_id);
+        return n.removed || n.p.m_x != _pos.m_x || n.p.m_y != _pos.m_y || n.p.m_z != _pos.m_z;
+    };
+}
+
+void Graph::addLine(size_t _n1, size_t _n2)
+{
+    auto& lines = editLines();
+    size_t slot;
+    m_revision = ++s_revisions;
+    if(!lines.free.empty())
+    {
+        // take over a removed edge's line, so it's uploaded like any other edit
+        slot = lines.free.back();
+        lines.free.pop_back();
+        lines.indices[slot * 2] = static_cast<uint32_t>(std::min(_n1, _n2));
+        lines.indices[slot * 2 + 1] = static_cast<uint32_t>(std::max(_n1, _n2));
+        lines.edits.emplace_back(m_revision, slot);
+    }
+    else
+    {
+        // the buffer grows, so the renderer has to start again and has no use for the edits so far
+        slot = lines.indices.size() / 2;
+        lines.indices.push_back(static_cast<uint32_t>(std::min(_n1, _n2)));
+        lines.indices.push_back(static_cast<uint32_t>(std::max(_n1, _n2)));
+        lines.edits.clear();
+        m_baseRevision = m_revision;
+    }
+    lines.slot.emplace(edgeKey(_n1, _n2), slot);
+}
+
+void Graph::layoutLines()
+{
+    // every edge is stored both ways round, only keep the copy from the lower node
+    auto lines = std::make_shared<Lines>();
+    for(size_t n = 0; n < m_size; ++n)
+    {
+        for(auto& e : neighbours(n))
+        {
+            if(n < e.n)
+            {
+                lines->slot.emplace(edgeKey(n, e.n), lines->indices.size() / 2);
+                lines->indices.push_back(static_cast<uint32_t>(n));
+                lines->indices.push_back(static_cast<uint32_t>(e.n));
+            }
+        }
+    }
+    m_lines = std::move(lines);
+    m_revision = ++s_revisions;
+    m_baseRevision = m_revision;
+}
+
+size_t Graph::find_index(const std::vector<float> &_list, float _item, size_t _node) const
 {
     for(size_t i = 0; i < _list.size(); ++i)
     {
         if(FCompare(_list[i], _item))
         {
             // Protect against same length
-            if(std::find(_eId.begin(), _eId.end(), i) == _eId.end())
+            if(!isEdge(_node, i))
             {
                 return i;
             }
@@ -206,32 +593,23 @@ size_t Graph::find_index(std::vector<float> _list, float _item, std::vector<size
     return _list.size();
 }
 
-float Graph::heuristic_cost_estimate(size_t _self, size_t _goal)
+float Graph::heuristic_cost_estimate(size_t _self, size_t _goal) const
 {
     // distance between the two nodes
-    return (m_graph[_goal].p - m_graph[_self].p).length();
+    return (at(_goal).p - at(_self).p).length();
 }
 
-std::vector<ngl::Vec3> Graph::reconstructPath(std::vector<size_t> _cameFrom, size_t _current)
+std::vector<size_t> Graph::reconstructPath(const std::vector<size_t> &_cameFrom, size_t _current) const
 {
-    std::vector<ngl::Vec3> path;
+    std::vector<size_t> path;
     auto ncf = _current;
     while(_cameFrom[ncf] != ncf)
     {
-        // insert position
-        path.insert(path.begin(), m_graph[ncf].p);
+        // store node, reversed once at the end
+        path.push_back(ncf);
         // update ncf
         ncf = _cameFrom[ncf];
     }
+    std::reverse(path.begin(), path.end());
     return path;
 }
-
-std::vector<size_t> Graph::Node::edgeId() const
-{
-    std::vector<size_t> eId;
-    for(auto e : this->es)
-    {
-        eId.push_back(e.n);
-    }
-    return eId;
-}
@@ -0,0 +1,91 @@
+#include "GraphBuilder.h"
+
+GraphBuilder::GraphBuilder(std::function<void(float)> _onProgress, std::function<void(Graph)> _onReady) :
+    m_onProgress(std::move(_onProgress)), m_onReady(std::move(_onReady))
+{
+    m_worker = std::thread(&GraphBuilder::workerLoop, this);
+}
+
+GraphBuilder::~GraphBuilder()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+        m_pending = nullptr;
+    }
+    m_wake.notify_one();
+    m_worker.join();
+}
+
+void GraphBuilder::build(Job _job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending = std::move(_job);
+        ++m_requested;
+    }
+    m_wake.notify_one();
+}
+
+bool GraphBuilder::isBuilding() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_finished != m_requested;
+}
+
+void GraphBuilder::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [&] { return m_finished == m_requested; });
+}
+
+void GraphBuilder::workerLoop()
+{
+    for(;;)
+    {
+        Job job;
+        uint64_t request;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_quit || m_pending; });
+            if(m_quit)
+            {
+                return;
+            }
+            job = std::move(m_pending);
+            m_pending = nullptr;
+            request = m_requested;
+        }
+        // a newer request makes this one stale, stop reporting its progress, tell the job to give up and drop its graph
+        auto current = [&]
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return request == m_requested && !m_quit;
+        };
+        auto graph = job([&](float _done)
+        {
+            if(!current())
+            {
+                return false;
+            }
+            if(m_onProgress)
+            {
+                m_onProgress(_done);
+            }
+            return true;
+        });
+        if(current() && m_onReady)
+        {
+            m_onReady(std::move(graph));
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // only the newest request counts as finished, isBuilding stays true while a stale one runs
+            if(request == m_requested)
+            {
+                m_finished = request;
+            }
+        }
+        m_idle.notify_all();
+    }
+}
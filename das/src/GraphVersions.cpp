@@ -0,0 +1,127 @@
+#include <thread>
+#include "GraphVersions.h"
+
+constexpr size_t GraphVersions::MaxReaders;
+
+GraphVersions::Snapshot::~Snapshot()
+{
+    if(m_slot)
+    {
+        // we're done with the version, an editor seeing the free slot can now let it go
+        m_slot->epoch.store(0);
+    }
+}
+
+const Graph& GraphVersions::Snapshot::operator*() const
+{
+    return m_version->graph;
+}
+
+uint64_t GraphVersions::Snapshot::version() const
+{
+    return m_version->number;
+}
+
+GraphVersions::GraphVersions(Graph _graph) :
+    m_current(new Version(std::move(_graph), 0))
+{
+}
+
+GraphVersions::~GraphVersions()
+{
+    delete m_current.load();
+    for(auto& r : m_retired)
+    {
+        delete r.second;
+    }
+}
+
+GraphVersions::Snapshot GraphVersions::read() const
+{
+    // start where this thread found a free slot last time, so regular readers don't fight over the same one
+    thread_local size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+    for(size_t i = 0; ; ++i)
+    {
+        auto& slot = m_slots[(hint + i) % MaxReaders];
+        uint64_t free = 0;
+        // announce the epoch before taking the version, an editor swapping after this will wait for us
+        if(slot.epoch.load(std::memory_order_relaxed) == 0 && slot.epoch.compare_exchange_strong(free, m_epoch.load()))
+        {
+            hint = (hint + i) % MaxReaders;
+            return Snapshot(&slot, m_current.load());
+        }
+        if(i % MaxReaders == MaxReaders - 1)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+uint64_t GraphVersions::version() const
+{
+    return m_current.load()->number;
+}
+
+uint64_t GraphVersions::edit(const std::function<void(Graph&)> &_edit)
+{
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    // the copy shares every node block with the current version until _edit changes one
+    Graph graph = m_current.load()->graph;
+    _edit(graph);
+    return swapIn(std::move(graph));
+}
+
+uint64_t GraphVersions::publish(Graph _graph)
+{
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    return swapIn(std::move(_graph));
+}
+
+size_t GraphVersions::retired() const
+{
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    return m_retired.size();
+}
+
+void GraphVersions::reclaim()
+{
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    reclaimLocked();
+}
+
+uint64_t GraphVersions::swapIn(Graph _graph)
+{
+    auto number = m_current.load()->number + 1;
+    auto old = m_current.exchange(new Version(std::move(_graph), number));
+    // readers announcing this epoch or later started after the swap, so can't have the old version
+    m_retired.emplace_back(m_epoch.fetch_add(1) + 1, old);
+    reclaimLocked();
+    return number;
+}
+
+void GraphVersions::reclaimLocked()
+{
+    // oldest epoch a reader is still in, anything retired at or before it is unreachable
+    uint64_t oldest = m_epoch.load();
+    for(auto& s : m_slots)
+    {
+        auto e = s.epoch.load();
+        if(e != 0 && e < oldest)
+        {
+            oldest = e;
+        }
+    }
+    size_t kept = 0;
+    for(auto& r : m_retired)
+    {
+        if(r.first <= oldest)
+        {
+            delete r.second;
+        }
+        else
+        {
+            m_retired[kept++] = r;
+        }
+    }
+    m_retired.resize(kept);
+}
@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <limits>
+#include "KdTree.h"
+
+namespace
+{
+    float coord(const ngl::Vec3 &_p, uint8_t _axis)
+    {
+        return (_axis == 0) ? _p.m_x : ((_axis == 1) ? _p.m_y : _p.m_z);
+    }
+}
+
+KdTree::KdTree(const std::vector<ngl::Vec3> &_points, ThreadPool *_pool) : m_points(_points.size()),
+    m_ids(_points.size()), m_axis(_points.size())
+{
+    // points and ids sit side by side while they're partitioned, then split into the arrays searches use
+    std::vector<Entry> entries(_points.size());
+    for(size_t i = 0; i < _points.size(); ++i)
+    {
+        entries[i] = {_points[i], i};
+    }
+    // the top few levels one after the other, until there are enough disjoint subtrees to go round the threads
+    std::vector<std::pair<size_t, size_t>> ranges = {{0, entries.size()}};
+    size_t wanted = _pool ? _pool->size() * 4 : 1;
+    while(ranges.size() < wanted && entries.size() > wanted * 64)
+    {
+        std::vector<std::pair<size_t, size_t>> halves;
+        for(auto& r : ranges)
+        {
+            auto mid = split(entries, r.first, r.second);
+            halves.push_back({r.first, mid});
+            halves.push_back({mid + 1, r.second});
+        }
+        ranges.swap(halves);
+    }
+    auto buildRanges = [&](size_t _begin, size_t _end)
+    {
+        for(size_t i = _begin; i < _end; ++i)
+        {
+            build(entries, ranges[i].first, ranges[i].second);
+        }
+    };
+    if(_pool)
+    {
+        _pool->parallelFor(ranges.size(), 1, buildRanges);
+    }
+    else
+    {
+        buildRanges(0, ranges.size());
+    }
+    for(size_t i = 0; i < entries.size(); ++i)
+    {
+        m_points[i] = entries[i].pos;
+        m_ids[i] = entries[i].id;
+    }
+}
+
+size_t KdTree::nearest(const ngl::Vec3 &_pos) const
+{
+    if(m_points.empty())
+    {
+        return 0;
+    }
+    size_t best = 0;
+    float bestDist = std::numeric_limits<float>::max();
+    search(0, m_points.size(), _pos, best, bestDist);
+    return m_ids[best];
+}
+
+std::vector<size_t> KdTree::nearest(const std::vector<ngl::Vec3> &_pos, ThreadPool *_pool) const
+{
+    std::vector<size_t> ids(_pos.size());
+    auto query = [&](size_t _begin, size_t _end)
+    {
+        for(size_t i = _begin; i < _end; ++i)
+        {
+            ids[i] = nearest(_pos[i]);
+        }
+    };
+    if(_pool)
+    {
+        _pool->parallelFor(_pos.size(), 1024, query);
+    }
+    else
+    {
+        query(0, _pos.size());
+    }
+    return ids;
+}
+
+size_t KdTree::nearest(const ngl::Vec3 &_pos, size_t _k, size_t *_ids, float *_dists) const
+{
+    size_t found = 0;
+    if(_k > 0)
+    {
+        search(0, m_points.size(), _pos, _k, _ids, _dists, found);
+    }
+    return found;
+}
+
+void KdTree::build(std::vector<Entry> &_entries, size_t _begin, size_t _end)
+{
+    if(_end - _begin < 2)
+    {
+        return;
+    }
+    auto mid = split(_entries, _begin, _end);
+    build(_entries, _begin, mid);
+    build(_entries, mid + 1, _end);
+}
+
+size_t KdTree::split(std::vector<Entry> &_entries, size_t _begin, size_t _end)
+{
+    // split along the axis the range is widest in
+    ngl::Vec3 lo = _entries[_begin].pos;
+    ngl::Vec3 hi = lo;
+    for(size_t i = _begin + 1; i < _end; ++i)
+    {
+        auto& p = _entries[i].pos;
+        lo.m_x = std::min(lo.m_x, p.m_x); hi.m_x = std::max(hi.m_x, p.m_x);
+        lo.m_y = std::min(lo.m_y, p.m_y); hi.m_y = std::max(hi.m_y, p.m_y);
+        lo.m_z = std::min(lo.m_z, p.m_z); hi.m_z = std::max(hi.m_z, p.m_z);
+    }
+    auto extent = hi - lo;
+    uint8_t axis = (extent.m_x >= extent.m_y && extent.m_x >= extent.m_z) ? 0 : ((extent.m_y >= extent.m_z) ? 1 : 2);
+    // partition around the median, points and ids move together
+    auto mid = _begin + (_end - _begin) / 2;
+    std::nth_element(_entries.begin() + static_cast<long>(_begin), _entries.begin() + static_cast<long>(mid),
+                     _entries.begin() + static_cast<long>(_end),
+                     [axis](const Entry &_a, const Entry &_b) { return coord(_a.pos, axis) < coord(_b.pos, axis); });
+    m_axis[mid] = axis;
+    return mid;
+}
+
+void KdTree::search(size_t _begin, size_t _end, const ngl::Vec3 &_pos, size_t &_best, float &_bestDist) const
+{
+    if(_begin >= _end)
+    {
+        return;
+    }
+    auto mid = _begin + (_end - _begin) / 2;
+    auto dist = (m_points[mid] - _pos).lengthSquared();
+    // ties go to the lower original index, so results don't depend on the tree layout
+    if(dist < _bestDist || (dist == _bestDist && m_ids[mid] < m_ids[_best]))
+    {
+        _best = mid;
+        _bestDist = dist;
+    }
+    if(_end - _begin == 1)
+    {
+        return;
+    }
+    // search our side of the split first, the other side only if the best sphere crosses it
+    auto axis = m_axis[mid];
+    auto diff = coord(_pos, axis) - coord(m_points[mid], axis);
+    if(diff < 0.0f)
+    {
+        search(_begin, mid, _pos, _best, _bestDist);
+        if(diff * diff <= _bestDist)
+        {
+            search(mid + 1, _end, _pos, _best, _bestDist);
+        }
+    }
+    else
+    {
+        search(mid + 1, _end, _pos, _best, _bestDist);
+        if(diff * diff <= _bestDist)
+        {
+            search(_begin, mid, _pos, _best, _bestDist);
+        }
+    }
+}
+
+void KdTree::search(size_t _begin, size_t _end, const ngl::Vec3 &_pos, size_t _k,
+                    size_t *_ids, float *_dists, size_t &_found) const
+{
+    if(_begin >= _end)
+    {
+        return;
+    }
+    auto mid = _begin + (_end - _begin) / 2;
+    auto dist = (m_points[mid] - _pos).lengthSquared();
+    auto id = m_ids[mid];
+    // insertion into the sorted best list, same tie break as the single nearest search
+    auto closer = [&](size_t _slot) { return dist < _dists[_slot] || (dist == _dists[_slot] && id < _ids[_slot]); };
+    if(_found < _k || closer(_found - 1))
+    {
+        size_t slot = (_found < _k) ? _found++ : _k - 1;
+        while(slot > 0 && closer(slot - 1))
+        {
+            _ids[slot] = _ids[slot - 1];
+            _dists[slot] = _dists[slot - 1];
+            --slot;
+        }
+        _ids[slot] = id;
+        _dists[slot] = dist;
+    }
+    if(_end - _begin == 1)
+    {
+        return;
+    }
+    // the far side only matters while the list isn't full or its worst could be beaten
+    auto axis = m_axis[mid];
+    auto diff = coord(_pos, axis) - coord(m_points[mid], axis);
+    bool left = diff < 0.0f;
+    search(left ? _begin : mid + 1, left ? mid : _end, _pos, _k, _ids, _dists, _found);
+    if(_found < _k || diff * diff <= _dists[_found - 1])
+    {
+        search(left ? mid + 1 : _begin, left ? _end : mid, _pos, _k, _ids, _dists, _found);
+    }
+}
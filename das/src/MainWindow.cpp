@@ -19,8 +19,10 @@ MainWindow::MainWindow(QWidget *parent) :QMainWindow(parent), m_ui(new Ui::MainW
   connect(m_ui->m_changeGoal, SIGNAL(clicked()), m_gl, SLOT(changeGoal()));
   // OTHER OPTIONS
   connect(m_ui->m_graphSelection, SIGNAL(currentIndexChanged(int)), m_gl, SLOT(setGraphType(int)));
+  connect(m_gl, SIGNAL(graphProgress(int)), m_ui->m_graphProgress, SLOT(setValue(int)));
   connect(m_ui->m_visibleTeapot, SIGNAL(toggled(bool)), m_gl, SLOT(setTeapotVisible(bool)));
   connect(m_ui->m_teapotEffectOn, SIGNAL(toggled(bool)), m_gl, SLOT(setTeapotEffectToggle(bool)));
+  connect(m_ui->m_teapotColorMapping, SIGNAL(currentIndexChanged(int)), m_gl, SLOT(setTeapotColorMapping(int)));
 
 //  connect(m_ui->m_wireframe,SIGNAL(toggled(bool)),m_gl,SLOT(toggleWireframe(bool)));
 //  // set the rotation signals
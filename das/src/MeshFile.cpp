@@ -0,0 +1,158 @@
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MeshFile.h"
+
+namespace
+{
+    // on disk header, the arrays follow straight after. Read and written as is, so little endian hosts only
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t numVertices;
+        uint32_t numIndices;
+        uint32_t flags;
+        uint32_t reserved;
+    };
+    const char Magic[4] = {'D', 'A', 'S', 'M'};
+    const uint32_t Version = 1;
+}
+
+MeshFile::MeshFile(const std::string &_path)
+{
+    open(_path);
+}
+
+MeshFile::~MeshFile()
+{
+    close();
+}
+
+bool MeshFile::open(const std::string &_path)
+{
+    close();
+    int fd = ::open(_path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header))
+    {
+        ::close(fd);
+        return false;
+    }
+    m_size = static_cast<size_t>(st.st_size);
+    auto data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file alive on its own
+    ::close(fd);
+    if(data == MAP_FAILED)
+    {
+        return false;
+    }
+    m_data = data;
+
+    // check the header and that the file is as long as it claims
+    Header header;
+    std::memcpy(&header, m_data, sizeof(Header));
+    auto bytes = static_cast<const char*>(m_data);
+    uint64_t normals = (header.flags & HasNormals) ? 1 : 0;
+    uint64_t expected = sizeof(Header) + (1 + normals) * 3 * sizeof(float) * uint64_t(header.numVertices) +
+                        sizeof(uint32_t) * uint64_t(header.numIndices);
+    if(std::memcmp(header.magic, Magic, 4) != 0 || header.version != Version ||
+       header.numIndices % 3 != 0 || expected > m_size)
+    {
+        close();
+        return false;
+    }
+    m_numVertices = header.numVertices;
+    m_numIndices = header.numIndices;
+    m_positions = reinterpret_cast<const float*>(bytes + sizeof(Header));
+    m_normals = normals ? m_positions + 3 * m_numVertices : nullptr;
+    m_indices = reinterpret_cast<const uint32_t*>(m_positions + (1 + normals) * 3 * m_numVertices);
+    // one bad index would read past the vertices when drawn
+    for(size_t i = 0; i < m_numIndices; ++i)
+    {
+        if(m_indices[i] >= m_numVertices)
+        {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void MeshFile::close()
+{
+    if(m_data)
+    {
+        munmap(m_data, m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_numVertices = 0;
+    m_numIndices = 0;
+    m_positions = nullptr;
+    m_normals = nullptr;
+    m_indices = nullptr;
+}
+
+void MeshFile::positions(std::vector<ngl::Vec3> &_out) const
+{
+    _out.clear();
+    _out.reserve(m_numVertices);
+    for(size_t i = 0; i < m_numVertices; ++i)
+    {
+        _out.push_back(ngl::Vec3(m_positions[i * 3], m_positions[i * 3 + 1], m_positions[i * 3 + 2]));
+    }
+}
+
+void MeshFile::normals(std::vector<ngl::Vec3> &_out) const
+{
+    _out.clear();
+    if(!m_normals)
+    {
+        return;
+    }
+    _out.reserve(m_numVertices);
+    for(size_t i = 0; i < m_numVertices; ++i)
+    {
+        _out.push_back(ngl::Vec3(m_normals[i * 3], m_normals[i * 3 + 1], m_normals[i * 3 + 2]));
+    }
+}
+
+bool MeshFile::write(const std::string &_path, const std::vector<ngl::Vec3> &_vertices,
+                     const std::vector<ngl::Vec3> &_normals, const std::vector<uint32_t> &_indices)
+{
+    if(!_normals.empty() && _normals.size() != _vertices.size())
+    {
+        return false;
+    }
+    std::ofstream out(_path, std::ios::binary);
+    if(!out)
+    {
+        return false;
+    }
+    Header header;
+    std::memcpy(header.magic, Magic, 4);
+    header.version = Version;
+    header.numVertices = static_cast<uint32_t>(_vertices.size());
+    header.numIndices = static_cast<uint32_t>(_indices.size());
+    header.flags = _normals.empty() ? 0u : static_cast<uint32_t>(HasNormals);
+    header.reserved = 0;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    for(auto list : {&_vertices, &_normals})
+    {
+        for(auto& v : *list)
+        {
+            float xyz[3] = {v.m_x, v.m_y, v.m_z};
+            out.write(reinterpret_cast<const char*>(xyz), sizeof(xyz));
+        }
+    }
+    out.write(reinterpret_cast<const char*>(_indices.data()), static_cast<std::streamsize>(_indices.size() * sizeof(uint32_t)));
+    return static_cast<bool>(out);
+}
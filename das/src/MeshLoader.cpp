@@ -0,0 +1,365 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include "MeshFile.h"
+#include "MeshLoader.h"
+
+namespace
+{
+    // indices are stored as uint32, anything this big or more is rejected before it's narrowed
+    const int64_t MaxIndex = std::numeric_limits<uint32_t>::max();
+    // longest polygon a PLY face list may claim, far beyond any real mesh
+    const double MaxListLength = 1 << 20;
+    // most vertices reserved up front when the stream length can't be checked against the header
+    const size_t MaxReserve = 1 << 20;
+
+    // bytes left to read, or the largest size_t if the stream can't tell
+    size_t remaining(std::istream &_in)
+    {
+        auto here = _in.tellg();
+        if(here < 0 || !_in.seekg(0, std::ios::end))
+        {
+            _in.clear();
+            return std::numeric_limits<size_t>::max();
+        }
+        auto end = _in.tellg();
+        _in.seekg(here);
+        return (end > here) ? static_cast<size_t>(end - here) : 0;
+    }
+
+    // PLY property types
+    enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Unknown };
+
+    PlyType plyType(const std::string &_name)
+    {
+        if(_name == "char" || _name == "int8") return PlyType::Int8;
+        if(_name == "uchar" || _name == "uint8") return PlyType::UInt8;
+        if(_name == "short" || _name == "int16") return PlyType::Int16;
+        if(_name == "ushort" || _name == "uint16") return PlyType::UInt16;
+        if(_name == "int" || _name == "int32") return PlyType::Int32;
+        if(_name == "uint" || _name == "uint32") return PlyType::UInt32;
+        if(_name == "float" || _name == "float32") return PlyType::Float32;
+        if(_name == "double" || _name == "float64") return PlyType::Float64;
+        return PlyType::Unknown;
+    }
+
+    struct PlyProperty
+    {
+        std::string name;
+        PlyType type;
+        bool isList;
+        PlyType countType;  // lists only
+    };
+
+    struct PlyElement
+    {
+        std::string name;
+        size_t count;
+        std::vector<PlyProperty> props;
+    };
+
+    // reads one value of _type, as text or little endian binary
+    template<typename T>
+    bool readBinary(std::istream &_in, double &_out)
+    {
+        T value;
+        if(!_in.read(reinterpret_cast<char*>(&value), sizeof(T)))
+        {
+            return false;
+        }
+        _out = static_cast<double>(value);
+        return true;
+    }
+
+    bool readPlyValue(std::istream &_in, bool _ascii, PlyType _type, double &_out)
+    {
+        if(_ascii)
+        {
+            return static_cast<bool>(_in >> _out);
+        }
+        switch(_type)
+        {
+        case PlyType::Int8: return readBinary<int8_t>(_in, _out);
+        case PlyType::UInt8: return readBinary<uint8_t>(_in, _out);
+        case PlyType::Int16: return readBinary<int16_t>(_in, _out);
+        case PlyType::UInt16: return readBinary<uint16_t>(_in, _out);
+        case PlyType::Int32: return readBinary<int32_t>(_in, _out);
+        case PlyType::UInt32: return readBinary<uint32_t>(_in, _out);
+        case PlyType::Float32: return readBinary<float>(_in, _out);
+        case PlyType::Float64: return readBinary<double>(_in, _out);
+        default: return false;
+        }
+    }
+
+    // splits a polygon into a fan of triangles
+    void addPolygon(const std::vector<int64_t> &_poly, std::vector<uint32_t> &_indices)
+    {
+        for(size_t i = 2; i < _poly.size(); ++i)
+        {
+            _indices.push_back(static_cast<uint32_t>(_poly[0]));
+            _indices.push_back(static_cast<uint32_t>(_poly[i - 1]));
+            _indices.push_back(static_cast<uint32_t>(_poly[i]));
+        }
+    }
+
+    bool indicesInRange(const std::vector<ngl::Vec3> &_vertices, const std::vector<uint32_t> &_indices)
+    {
+        return std::all_of(_indices.begin(), _indices.end(), [&](uint32_t _i) { return _i < _vertices.size(); });
+    }
+
+    bool fail(std::vector<ngl::Vec3> &_vertices, std::vector<uint32_t> &_indices)
+    {
+        _vertices.clear();
+        _indices.clear();
+        return false;
+    }
+}
+
+bool MeshLoader::load(const std::string &_path, std::vector<ngl::Vec3> &_vertices, std::vector<uint32_t> &_indices)
+{
+    auto dot = _path.find_last_of('.');
+    std::string ext = (dot == std::string::npos) ? "" : _path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char _c) { return std::tolower(_c); });
+    if(ext == "dasm")
+    {
+        MeshFile file;
+        if(!file.open(_path))
+        {
+            return fail(_vertices, _indices);
+        }
+        file.positions(_vertices);
+        _indices.assign(file.indices(), file.indices() + file.numIndices());
+        return true;
+    }
+    std::ifstream in(_path, std::ios::binary);
+    if(!in)
+    {
+        return fail(_vertices, _indices);
+    }
+    if(ext == "obj")
+    {
+        return loadObj(in, _vertices, _indices);
+    }
+    if(ext == "ply")
+    {
+        return loadPly(in, _vertices, _indices);
+    }
+    return fail(_vertices, _indices);
+}
+
+bool MeshLoader::loadObj(std::istream &_in, std::vector<ngl::Vec3> &_vertices, std::vector<uint32_t> &_indices)
+{
+    _vertices.clear();
+    _indices.clear();
+    std::string line;
+    std::vector<int64_t> poly;
+    while(std::getline(_in, line))
+    {
+        auto s = line.c_str();
+        if(s[0] == 'v' && std::isspace(static_cast<unsigned char>(s[1])))
+        {
+            char *end;
+            float xyz[3];
+            s += 2;
+            for(auto& c : xyz)
+            {
+                c = std::strtof(s, &end);
+                if(end == s)
+                {
+                    return fail(_vertices, _indices);
+                }
+                s = end;
+            }
+            _vertices.push_back(ngl::Vec3(xyz[0], xyz[1], xyz[2]));
+        }
+        else if(s[0] == 'f' && std::isspace(static_cast<unsigned char>(s[1])))
+        {
+            // each corner is v, v/vt, v//vn or v/vt/vn, only v matters
+            poly.clear();
+            s += 2;
+            for(;;)
+            {
+                while(std::isspace(static_cast<unsigned char>(*s)))
+                {
+                    ++s;
+                }
+                if(*s == '\0')
+                {
+                    break;
+                }
+                char *end;
+                auto v = std::strtoll(s, &end, 10);
+                if(end == s || v == 0)
+                {
+                    return fail(_vertices, _indices);
+                }
+                // negative indices count back from the latest vertex
+                poly.push_back(v < 0 ? static_cast<int64_t>(_vertices.size()) + v : v - 1);
+                if(poly.back() < 0 || poly.back() >= MaxIndex)
+                {
+                    return fail(_vertices, _indices);
+                }
+                s = end;
+                while(*s != '\0' && !std::isspace(static_cast<unsigned char>(*s)))
+                {
+                    ++s;
+                }
+            }
+            addPolygon(poly, _indices);
+        }
+    }
+    if(!indicesInRange(_vertices, _indices))
+    {
+        return fail(_vertices, _indices);
+    }
+    return true;
+}
+
+bool MeshLoader::loadPly(std::istream &_in, std::vector<ngl::Vec3> &_vertices, std::vector<uint32_t> &_indices)
+{
+    _vertices.clear();
+    _indices.clear();
+    // header
+    std::string line;
+    if(!std::getline(_in, line) || line.compare(0, 3, "ply") != 0)
+    {
+        return fail(_vertices, _indices);
+    }
+    bool ascii = false;
+    std::vector<PlyElement> elements;
+    for(;;)
+    {
+        if(!std::getline(_in, line))
+        {
+            return fail(_vertices, _indices);
+        }
+        if(!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        std::istringstream words(line);
+        std::string word;
+        words >> word;
+        if(word == "end_header")
+        {
+            break;
+        }
+        if(word == "format")
+        {
+            words >> word;
+            if(word == "ascii")
+            {
+                ascii = true;
+            }
+            else if(word != "binary_little_endian")
+            {
+                return fail(_vertices, _indices);
+            }
+        }
+        else if(word == "element")
+        {
+            PlyElement e;
+            if(!(words >> e.name >> e.count))
+            {
+                return fail(_vertices, _indices);
+            }
+            elements.push_back(e);
+        }
+        else if(word == "property" && !elements.empty())
+        {
+            PlyProperty p;
+            std::string type;
+            words >> type;
+            p.isList = (type == "list");
+            if(p.isList)
+            {
+                std::string countType;
+                words >> countType >> type;
+                p.countType = plyType(countType);
+            }
+            p.type = plyType(type);
+            words >> p.name;
+            if(p.type == PlyType::Unknown || (p.isList && p.countType == PlyType::Unknown))
+            {
+                return fail(_vertices, _indices);
+            }
+            elements.back().props.push_back(p);
+        }
+    }
+    // body, an element at a time
+    std::vector<int64_t> poly;
+    for(auto& e : elements)
+    {
+        bool isVertex = (e.name == "vertex");
+        bool isFace = (e.name == "face");
+        if(isVertex)
+        {
+            // the header count is only a claim, every property takes at least a byte so it can't be more than that
+            auto left = remaining(_in);
+            auto most = e.props.empty() ? 0 : left / e.props.size();
+            _vertices.reserve(std::min(e.count, left == std::numeric_limits<size_t>::max() ? MaxReserve : most));
+        }
+        for(size_t i = 0; i < e.count; ++i)
+        {
+            double xyz[3] = {0.0, 0.0, 0.0};
+            for(auto& p : e.props)
+            {
+                double value;
+                if(!p.isList)
+                {
+                    if(!readPlyValue(_in, ascii, p.type, value))
+                    {
+                        return fail(_vertices, _indices);
+                    }
+                    if(isVertex && p.name.size() == 1 && p.name[0] >= 'x' && p.name[0] <= 'z')
+                    {
+                        xyz[p.name[0] - 'x'] = value;
+                    }
+                    continue;
+                }
+                double count;
+                if(!readPlyValue(_in, ascii, p.countType, count) || !std::isfinite(count) || count < 0.0 ||
+                   count > MaxListLength)
+                {
+                    return fail(_vertices, _indices);
+                }
+                bool isCorners = isFace && (p.name == "vertex_indices" || p.name == "vertex_index");
+                poly.clear();
+                for(size_t c = 0; c < static_cast<size_t>(count); ++c)
+                {
+                    if(!readPlyValue(_in, ascii, p.type, value) || value < 0.0)
+                    {
+                        return fail(_vertices, _indices);
+                    }
+                    if(isCorners)
+                    {
+                        if(!std::isfinite(value) || value >= static_cast<double>(MaxIndex))
+                        {
+                            return fail(_vertices, _indices);
+                        }
+                        poly.push_back(static_cast<int64_t>(value));
+                    }
+                }
+                if(isCorners)
+                {
+                    addPolygon(poly, _indices);
+                }
+            }
+            if(isVertex)
+            {
+                _vertices.push_back(ngl::Vec3(static_cast<float>(xyz[0]), static_cast<float>(xyz[1]),
+                                              static_cast<float>(xyz[2])));
+            }
+        }
+    }
+    if(!indicesInRange(_vertices, _indices))
+    {
+        return fail(_vertices, _indices);
+    }
+    return true;
+}
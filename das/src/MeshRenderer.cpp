@@ -0,0 +1,105 @@
+#include "MeshRenderer.h"
+
+MeshRenderer::~MeshRenderer()
+{
+    glDeleteVertexArrays(1, &m_vao);
+    glDeleteTextures(1, &m_colorTexture);
+    GLuint buffers[4] = {m_vertexBuffer, m_indexBuffer, m_colorBuffer, m_vertexColorBuffer};
+    glDeleteBuffers(4, buffers);
+}
+
+void MeshRenderer::setMesh(const std::vector<ngl::Vec3> &_vertices, const std::vector<uint32_t> &_indices)
+{
+    if(m_vao == 0)
+    {
+        glGenVertexArrays(1, &m_vao);
+        glGenBuffers(1, &m_vertexBuffer);
+        glGenBuffers(1, &m_indexBuffer);
+        glGenBuffers(1, &m_colorBuffer);
+        glGenBuffers(1, &m_vertexColorBuffer);
+        glGenTextures(1, &m_colorTexture);
+    }
+    m_numIndices = static_cast<GLsizei>(_indices.size());
+    glBindVertexArray(m_vao);
+    // shape never changes once it's up
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(_vertices.size() * sizeof(ngl::Vec3)),
+                 _vertices.empty() ? nullptr : &_vertices[0].m_x, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ngl::Vec3), nullptr);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(_indices.size() * sizeof(uint32_t)),
+                 _indices.empty() ? nullptr : _indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+}
+
+void MeshRenderer::setColors(const std::vector<ngl::Vec3> &_colors)
+{
+    if(m_vao == 0)
+    {
+        return;
+    }
+    if(m_hasVertexColors)
+    {
+        // back to the palette, the shader takes the constant attribute value when the array is off
+        glBindVertexArray(m_vao);
+        glDisableVertexAttribArray(1);
+        glBindVertexArray(0);
+        m_hasVertexColors = false;
+    }
+    m_numColors = _colors.size();
+    auto bytes = static_cast<GLsizeiptr>(_colors.size() * sizeof(ngl::Vec3));
+    glBindBuffer(GL_TEXTURE_BUFFER, m_colorBuffer);
+    // orphan the old palette so we don't wait on a frame still drawing with it
+    glBufferData(GL_TEXTURE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    if(bytes > 0)
+    {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, &_colors[0].m_x);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, m_colorTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, m_colorBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+ngl::Vec3* MeshRenderer::mapVertexColors(size_t _n)
+{
+    if(m_vao == 0 || _n == 0)
+    {
+        return nullptr;
+    }
+    auto bytes = static_cast<GLsizeiptr>(_n * sizeof(ngl::Vec3));
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexColorBuffer);
+    // orphan and invalidate so the driver hands back fresh memory rather than syncing with the last frame
+    glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ngl::Vec3), nullptr);
+    m_hasVertexColors = true;
+    return static_cast<ngl::Vec3*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes,
+                                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+}
+
+void MeshRenderer::unmapVertexColors()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexColorBuffer);
+    // false means the contents were lost while mapped, draw stays valid and just shows junk for a frame
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void MeshRenderer::draw(GLuint _textureUnit) const
+{
+    if(m_numIndices == 0 || (m_numColors == 0 && !m_hasVertexColors))
+    {
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0 + _textureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, m_colorTexture);
+    glBindVertexArray(m_vao);
+    glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, nullptr);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
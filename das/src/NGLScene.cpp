@@ -1,14 +1,17 @@
 #include <QMouseEvent>
 #include <QGuiApplication>
+#include <QMetaObject>
 
 #include "NGLScene.h"
 #include <ngl/NGLInit.h>
 #include <ngl/Random.h>
 #include <ngl/ShaderLib.h>
-#include <ngl/SimpleVAO.h>
+#include <ngl/SimpleIndexVAO.h>
 #include <ngl/Transformation.h>
 #include <ngl/VAOFactory.h>
+#include <cstdlib>
 #include <iostream>
+#include <thread>
 
 NGLScene::NGLScene(QWidget *_parent )
 {
@@ -17,13 +20,58 @@ NGLScene::NGLScene(QWidget *_parent )
     // re-size the widget to that of the parent (in this case the GLFrame passed in on construction)
     this->resize(_parent->size());
     // initialize member variables
+    m_sim.setNumThreads(std::thread::hardware_concurrency());
+    // a run can be replayed by passing its seed back in through DAS_SEED
+    if(auto seed = std::getenv("DAS_SEED"))
+    {
+        m_sim.setSeed(std::strtoull(seed, nullptr, 10));
+    }
+    std::cout<<"Simulation seed: "<<m_sim.seed()<<"\n";
+    // any OBJ, PLY or .dasm mesh can stand in for the teapot
+    if(auto mesh = std::getenv("DAS_MESH"))
+    {
+        m_meshFromFile = m_mesh.load(mesh);
+        if(!m_meshFromFile)
+        {
+            std::cerr<<"Couldn't load mesh "<<mesh<<", using the teapot\n";
+        }
+    }
+    if(!m_meshFromFile)
+    {
+        m_mesh.setMesh(m_teapot.vertices(), m_teapot.indices());
+    }
+    // the random graphs are seeded from it too
+    ngl::Random::instance()->setSeed(static_cast<unsigned int>(m_sim.seed()));
+    // the simulation steps on its own thread and asks for a redraw whenever it has something new
+    m_simThread.reset(new SimulationThread(m_sim, m_frames, [this]
+    {
+        QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection);
+    }));
+    if(auto rate = std::getenv("DAS_TICK_RATE"))
+    {
+        m_simThread->setTickRate(std::strtod(rate, nullptr));
+    }
+    // new graphs are built in the background and swapped in between steps, the particles restart on them
+    m_graphBuilder.reset(new GraphBuilder([this](float _done)
+    {
+        emit graphProgress(static_cast<int>(_done * 100.0f));
+    },
+    [this](Graph _graph)
+    {
+        auto graph = std::make_shared<Graph>(std::move(_graph));
+        m_simThread->post([graph](ParticleSim &_sim) { _sim.setGraph(std::move(*graph)); });
+    }));
+    // paintGL colours meshes at the same time as the simulation steps, so it gets threads of its own
+    m_colorPool.reset(new ThreadPool(std::thread::hardware_concurrency()));
     setGraphType(0);
-    m_goal = m_graph.size() - 1;
 }
 
 
 NGLScene::~NGLScene()
 {
+  // no more graphs or frames for a window that's going away, a build still linking gives up at its next report
+  m_graphBuilder.reset();
+  m_simThread->stop();
   std::cout<<"Shutting down NGL, removing VAO's and Shaders\n";
 }
 
@@ -61,12 +109,12 @@ void NGLScene::initializeGL()
   //set the camera
   m_view = ngl::lookAt({1.5f, 2.0f, 3.0f}, ngl::Vec3::zero(), ngl::Vec3::up());
 
-  //make simple vaos for the lines and the teapot
-  m_lineVAO = ngl::VAOFactory::createVAO(ngl::simpleVAO, GL_LINES);
-  m_teapotVAO = ngl::VAOFactory::createVAO(ngl::simpleVAO, GL_TRIANGLES);
+  //make a vao for the lines, they index into the graph's node positions. The teapot shape goes up once
+  m_lineVAO = ngl::VAOFactory::createVAO(ngl::simpleIndexVAO, GL_LINES);
+  m_teapotRenderer.setMesh(m_mesh.vertices(), m_mesh.indices());
 
-  //make a primitive sphere for the particles
-  ngl::VAOPrimitives::instance()->createSphere("sphere", 0.03f, 40);
+  //particles are instanced spheres, or sprites once there are lots of them
+  m_particleRenderer.init(0.03f);
 }
 
 void NGLScene::paintGL()
@@ -81,191 +129,118 @@ void NGLScene::paintGL()
   rotx.rotateX(m_win.spinXFace);
   roty.rotateY(m_win.spinYFace);
   mouseRotation = roty * rotx;
-  // create line list from graph
-  auto lines = m_graph.render();
-  // render out the lines
+  // draw the latest state the simulation published, or the last one again if nothing newer has arrived
+  m_frames.update();
+  auto& frame = m_frames.front();
+  // render out the lines, the buffer only changes when the graph does
   m_lineVAO->bind();
-  m_lineVAO->setData(ngl::SimpleVAO::VertexData(lines.size()*sizeof(ngl::Vec3),
-                                          lines[0].m_x));
-  m_lineVAO->setVertexAttributePointer(0, 3, GL_FLOAT, sizeof(ngl::Vec3), 0);
-  m_lineVAO->setNumIndices(lines.size());
-  loadMatrixToShader(mouseRotation, ngl::Vec4(1.0f, 0.0f, 0.0f, 1.0f));
-  m_lineVAO->draw();
+  if(frame.graph)
+  {
+      updateLineBuffer(*frame.graph);
+      if(frame.graph->revision() != m_boundsRevision)
+      {
+          // particles never leave the graph, so its box is their half of the space the teapot is coloured in
+          m_mesh.setParticleBounds(frame.graph->positions());
+          m_boundsRevision = frame.graph->revision();
+      }
+  }
+  if(m_numLines > 0)
+  {
+      loadMatrixToShader(mouseRotation, ngl::Vec4(1.0f, 0.0f, 0.0f, 1.0f));
+      m_lineVAO->draw();
+  }
   m_lineVAO->unbind();
   // render out the particles
   if(m_visParticles)
   {
-      ngl::Transformation tx;
-      auto *prim = ngl::VAOPrimitives::instance();
-      for(auto p : m_particles)
-      {
-          ngl::Vec4 particleColor;
-          if(m_teapotEffectOn)
-          {
-              particleColor = p.pos;
-          }
-          else
-          {
-              particleColor = ngl::Vec4(0.0f, 1.0f, 0.0f, 1.0f);
-          }
-          tx.setPosition(p.pos);
-          loadMatrixToShader(mouseRotation * tx.getMatrix(), particleColor);
-          prim->draw("sphere");
-      }
+      // one draw call for the lot, coloured by position for the teapot effect
+      m_particleRenderer.update(frame.positions, m_teapotEffectOn, ngl::Vec3(0.0f, 1.0f, 0.0f));
+      m_particleRenderer.draw(m_project * m_view * mouseRotation, m_project, m_win.height);
   }
   // teapot rendering
   if(m_teapotVisible)
   {
-      std::vector<ngl::Vec3> teapotRender;
-      std::vector<ngl::Vec3> colorList;
-      // create teapot list
-      if(m_teapotEffectOn)
+      // colour the teapot by particle position, or plain red. Repeating the palette over the teapot is left to
+      // the shader so only one colour per particle goes up, the other mappings upload a colour per vertex
+      auto& colorList = m_teapotEffectOn ? frame.positions : m_noColors;
+      bool perVertex = m_meshFromFile || m_mesh.mapping() != ColorMesh::Mapping::Repeat;
+      if(!colorList.empty() && perVertex)
       {
-          //grab particle positions
-          for(auto p : m_particles)
+          // external meshes and the nearest particle mappings get a colour per vertex, written in chunks over
+          // m_colorPool, the render thread's own pool, straight into GL memory
+          if(auto out = m_teapotRenderer.mapVertexColors(m_mesh.numVertices()))
           {
-              colorList.push_back(p.pos);
+              m_mesh.mapColors(colorList, colorList, out, m_colorPool.get());
+              m_teapotRenderer.unmapVertexColors();
           }
+          m_teapotColorsFixed = false;
+      }
+      else if(!colorList.empty())
+      {
+          m_teapotRenderer.setColors(colorList);
+          m_teapotColorsFixed = false;
       }
-      else
+      else if(!m_teapotColorsFixed)
       {
-          colorList.push_back(ngl::Vec3(1.0f, 0.0f, 0.0f));
+          // doesn't change, so only needs sending once
+          m_teapotRenderer.setColors({ngl::Vec3(1.0f, 0.0f, 0.0f)});
+          m_teapotColorsFixed = true;
       }
-      teapotRender = m_teapot.render(colorList);
       // teapot transformation matrix
       ngl::Transformation tx;
       tx.setPosition(ngl::Vec3(-1.0f, -1.0f, 0.0f));
       //tx.setScale(ngl::Vec3(0.7f));
       //render out the teapot
-      m_teapotVAO->bind();
-      m_teapotVAO->setData(ngl::SimpleVAO::VertexData(teapotRender.size()*sizeof(ngl::Vec3),
-                                                      teapotRender[0].m_x));
-      m_teapotVAO->setVertexAttributePointer(0, 3, GL_FLOAT, 2*sizeof(ngl::Vec3), 0);
-      m_teapotVAO->setVertexAttributePointer(1, 3, GL_FLOAT, 2*sizeof(ngl::Vec3), 3);
-      m_teapotVAO->setNumIndices(teapotRender.size()/2);
       loadMatrixToTeapotShader(mouseRotation * tx.getMatrix());
-      m_teapotVAO->draw();
-      m_teapotVAO->unbind();
+      m_teapotRenderer.draw(0);
   }
 }
 
-void NGLScene::timerEvent(QTimerEvent *_event)
+void NGLScene::updateLineBuffer(const Graph &_graph)
 {
-    m_timerId = _event->timerId();
-    // goal change chance
-    if(m_isGoalRandom)
+    auto& graph = _graph;
+    auto& indices = graph.lineIndices();
+    if(graph.baseRevision() != m_lineBase)
     {
-        ngl::Random *rng = ngl::Random::instance();
-        if(rng->randomPositiveNumber() < 0.01f)
+        // new layout, every node position once and a pair of 32 bit indices per edge
+        m_numLines = indices.size() / 2;
+        if(m_numLines > 0)
         {
-            changeGoal();
+            auto points = graph.positions();
+            m_lineVAO->setData(ngl::SimpleIndexVAO::VertexData(points.size()*sizeof(ngl::Vec3), points[0].m_x,
+                                                               static_cast<unsigned int>(indices.size()),
+                                                               indices.data(), GL_UNSIGNED_INT));
+            m_lineVAO->setVertexAttributePointer(0, 3, GL_FLOAT, sizeof(ngl::Vec3), 0);
         }
+        m_lineVAO->setNumIndices(indices.size());
     }
-    // particle animations
-    animateParticles();
-    update();
-}
-
-void NGLScene::spawn()
-{
-    // check list completeness
-    if(m_particles.size() < m_numParticles)
+    else if(graph.revision() != m_lineRevision)
     {
-        // add particles
-        auto toAdd = m_numParticles - m_particles.size();
-        for(size_t i = 0; i < toAdd; ++i)
+        // same layout, positions never move so just rewrite the edited index pairs. The element
+        // buffer is part of the VAO state, so the bound VAO tells us which one it is
+        GLint indexBuffer = 0;
+        glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &indexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLuint>(indexBuffer));
+        for(auto run : graph.linesChangedSince(m_lineRevision))
         {
-            createParticle(m_goal);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+                            static_cast<GLintptr>(run.first * 2 * sizeof(uint32_t)),
+                            static_cast<GLsizeiptr>(run.count * 2 * sizeof(uint32_t)),
+                            &indices[run.first * 2]);
         }
     }
+    m_lineBase = graph.baseRevision();
+    m_lineRevision = graph.revision();
 }
 
-void NGLScene::createParticle(size_t _goal)
+void NGLScene::setGraph(std::vector<ngl::Vec3> _points, size_t _degree)
 {
-    // handle random start
-    ngl::Random *rng = ngl::Random::instance();
-    size_t start = static_cast<size_t>(rng->randomPositiveNumber(m_graph.size()-1));
-    // don't allow start == goal
-    while(start == _goal)
+    // linking the nodes up is the slow part, the old graph carries on running until it's done
+    auto points = std::make_shared<std::vector<ngl::Vec3>>(std::move(_points));
+    m_graphBuilder->build([points, _degree](const GraphBuilder::Progress &_progress)
     {
-        start = static_cast<size_t>(rng->randomPositiveNumber(m_graph.size()-1));
-    }
-    // create a particle and load it up
-    Particle p(m_graph.pos(start), m_graph.pos(_goal), 0.005f);
-    p.path = m_graph.aStar(start, _goal);
-    auto direction = p.path[0] - p.pos;
-    direction.normalize();
-    p.dir = direction;
-    m_particles.push_back(p);
-}
-
-void NGLScene::animateParticles()
-{
-    for(auto& p : m_particles)
-    {
-        // set direction
-        auto direction = p.path[0] - p.pos;
-        direction.normalize();
-        // check for path stage completion
-        if(direction != p.dir)
-        {
-            p.pos = p.path[0];
-            p.path.erase(p.path.begin());
-            if(p.path.size() == 0)
-            {
-                continue;
-            }
-            direction = p.path[0] - p.pos;
-            direction.normalize();
-            p.dir = direction;
-        }
-        // set new pos
-        p.pos += direction * p.speed;
-    }
-    prune(); // cut off particles that have reached their goals
-    spawn(); // spawn in new particles up to m_numParticles
-}
-
-void NGLScene::prune()
-{
-    for(auto it = m_particles.begin(); it != m_particles.end();)
-    {
-        if( it->path.size() == 0 )
-        {
-            it = m_particles.erase(it);
-        }
-        else
-        {
-            ++it;
-        }
-    }
-}
-
-void NGLScene::resetParticles()
-{
-    m_particles.clear();
-    randomGoal(); // get a goal for the new graph so goal is not out-of-index
-    spawn();
-}
-
-void NGLScene::resetParticleGoal()
-{
-    // reset the particles to the new goal
-    for(auto& p : m_particles)
-    {
-        p.goal = m_goal;
-        auto nextPos = p.path[0];
-        auto startNode = m_graph.node(nextPos);
-        auto newPath = m_graph.aStar(startNode, m_goal);
-        newPath.insert(newPath.begin(), nextPos);
-        p.path = newPath;
-    }
-}
-
-void NGLScene::randomGoal()
-{
-    ngl::Random *rng = ngl::Random::instance();
-    m_goal = static_cast<size_t>(rng->randomPositiveNumber(m_graph.size()-1));
+        return Graph(*points, _degree, _progress);
+    });
 }
 
 void NGLScene::loadMatrixToShader(const ngl::Mat4 &_tx, const ngl::Vec4 &_color)
@@ -281,6 +256,9 @@ void NGLScene::loadMatrixToTeapotShader(const ngl::Mat4 &_tx)
     ngl::ShaderLib *shader = ngl::ShaderLib::instance();
     shader->use("teapotShader");
     shader->setUniform("MVP", m_project * m_view * _tx);
+    shader->setUniform("particleColors", 0);
+    shader->setUniform("numColors", static_cast<int>(m_teapotRenderer.numColors()));
+    shader->setUniform("vertexColors", static_cast<int>(m_teapotRenderer.hasVertexColors()));
 }
 
 void NGLScene::makeGraph_2Dgrid(ngl::Vec2 _bl, ngl::Vec2 _tr, size_t _h, size_t _w)
@@ -298,8 +276,7 @@ void NGLScene::makeGraph_2Dgrid(ngl::Vec2 _bl, ngl::Vec2 _tr, size_t _h, size_t
             points.push_back(ngl::Vec3(x, y, 0.0f));
         }
     }
-    m_graph = Graph(points, 2);
-    resetParticles();
+    setGraph(std::move(points), 2);
 }
 
 void NGLScene::makeGraph_3Dgrid(ngl::Vec3 _bl, ngl::Vec3 _tr, size_t _h, size_t _w, size_t _d)
@@ -321,8 +298,7 @@ void NGLScene::makeGraph_3Dgrid(ngl::Vec3 _bl, ngl::Vec3 _tr, size_t _h, size_t
             }
         }
     }
-    m_graph = Graph(points, 3);
-    resetParticles();
+    setGraph(std::move(points), 3);
 }
 
 void NGLScene::makeGraph_2Drand(ngl::Vec2 _bl, ngl::Vec2 _tr, size_t _n, size_t _degree)
@@ -350,8 +326,7 @@ void NGLScene::makeGraph_2Drand(ngl::Vec2 _bl, ngl::Vec2 _tr, size_t _n, size_t
             points.push_back(p);
         }
     }
-    m_graph = Graph(points, _degree);
-    resetParticles();
+    setGraph(std::move(points), _degree);
 }
 
 void NGLScene::makeGraph_3Drand(ngl::Vec3 _bl, ngl::Vec3 _tr, size_t _n, size_t _degree)
@@ -380,8 +355,7 @@ void NGLScene::makeGraph_3Drand(ngl::Vec3 _bl, ngl::Vec3 _tr, size_t _n, size_t
             points.push_back(p);
         }
     }
-    m_graph = Graph(points, _degree);
-    resetParticles();
+    setGraph(std::move(points), _degree);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -412,29 +386,41 @@ void NGLScene::keyPressEvent(QKeyEvent *_event)
 void NGLScene::startSim()
 {
     m_visParticles = true;
-    startTimer(10);
+    m_simThread->start();
 }
 
 void NGLScene::stopSim()
 {
     m_visParticles = false;
-    killTimer(m_timerId);
+    m_simThread->stop();
+    // how long steps took while it ran, a power of two microseconds per row
+    std::cout<<"Simulation ticks: "<<m_simThread->ticks()<<", caught up "<<m_simThread->caughtUp()
+             <<", dropped "<<m_simThread->dropped()<<"\n";
+    auto histogram = m_simThread->histogram();
+    for(size_t b = 0; b < histogram.size(); ++b)
+    {
+        if(histogram[b] > 0)
+        {
+            std::cout<<"  < "<<(1u << b)<<" us: "<<histogram[b]<<"\n";
+        }
+    }
+    update();
 }
 
 void NGLScene::setNumParticles(int _i)
 {
-    m_numParticles = static_cast<size_t>(_i);
+    auto n = static_cast<size_t>(_i);
+    m_simThread->post([n](ParticleSim &_sim) { _sim.setNumParticles(n); });
 }
 
 void NGLScene::setRandomGoal(bool _isRandom)
 {
-    m_isGoalRandom = _isRandom;
+    m_simThread->post([_isRandom](ParticleSim &_sim) { _sim.setRandomGoal(_isRandom); });
 }
 
 void NGLScene::changeGoal()
 {
-    randomGoal();
-    resetParticleGoal();
+    m_simThread->post([](ParticleSim &_sim) { _sim.changeGoal(); });
 }
 
 void NGLScene::setGraphType(int _i)
@@ -452,7 +438,6 @@ void NGLScene::setGraphType(int _i)
         makeGraph_3Drand(ngl::Vec3(0.0f), ngl::Vec3(1.0f), 300, 4); break;
     default: break;
     }
-    // update gl window and redraw
     update();
 }
 
@@ -467,3 +452,16 @@ void NGLScene::setTeapotEffectToggle(bool _isOn)
     m_teapotEffectOn = _isOn;
     update();
 }
+
+void NGLScene::setTeapotColorMapping(int _i)
+{
+    // same order as the combo box
+    switch(_i)
+    {
+    case 0: m_mesh.setMapping(ColorMesh::Mapping::Repeat); break;
+    case 1: m_mesh.setMapping(ColorMesh::Mapping::Nearest); break;
+    case 2: m_mesh.setMapping(ColorMesh::Mapping::Blend); break;
+    default: break;
+    }
+    update();
+}
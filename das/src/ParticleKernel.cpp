@@ -0,0 +1,175 @@
+#include <atomic>
+#include "ParticleKernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define DAS_X86_SIMD 1
+    #include <immintrin.h>
+#endif
+
+namespace
+{
+
+size_t advanceScalar(const ParticleStepData &_d, float _dt, size_t _begin)
+{
+    size_t arrivals = 0;
+    for(size_t i = _begin; i < _d.size; ++i)
+    {
+        float step = _d.speed[i] * _dt;
+        float x = _d.px[i] + _d.dx[i] * step;
+        float y = _d.py[i] + _d.dy[i] * step;
+        float z = _d.pz[i] + _d.dz[i] * step;
+        // distance left to the target along the direction of travel, gone negative if we passed it
+        float ahead = (_d.tx[i] - x) * _d.dx[i] + (_d.ty[i] - y) * _d.dy[i] + (_d.tz[i] - z) * _d.dz[i];
+        if(ahead <= 0.0f)
+        {
+            x = _d.tx[i];
+            y = _d.ty[i];
+            z = _d.tz[i];
+            _d.arrived[i] = 1;
+            ++arrivals;
+        }
+        else
+        {
+            _d.arrived[i] = 0;
+        }
+        _d.px[i] = x;
+        _d.py[i] = y;
+        _d.pz[i] = z;
+    }
+    return arrivals;
+}
+
+#ifdef DAS_X86_SIMD
+// fp-contract is turned off so the compiler can't fuse the multiply/adds, keeping results identical to the scalar loop
+__attribute__((target("avx2"), optimize("fp-contract=off")))
+size_t advanceAVX2(const ParticleStepData &_d, float _dt)
+{
+    size_t arrivals = 0;
+    const __m256 dt = _mm256_set1_ps(_dt);
+    const __m256 zero = _mm256_setzero_ps();
+    size_t i = 0;
+    for(; i + 8 <= _d.size; i += 8)
+    {
+        __m256 dx = _mm256_loadu_ps(_d.dx + i);
+        __m256 dy = _mm256_loadu_ps(_d.dy + i);
+        __m256 dz = _mm256_loadu_ps(_d.dz + i);
+        __m256 tx = _mm256_loadu_ps(_d.tx + i);
+        __m256 ty = _mm256_loadu_ps(_d.ty + i);
+        __m256 tz = _mm256_loadu_ps(_d.tz + i);
+        __m256 step = _mm256_mul_ps(_mm256_loadu_ps(_d.speed + i), dt);
+        __m256 x = _mm256_add_ps(_mm256_loadu_ps(_d.px + i), _mm256_mul_ps(dx, step));
+        __m256 y = _mm256_add_ps(_mm256_loadu_ps(_d.py + i), _mm256_mul_ps(dy, step));
+        __m256 z = _mm256_add_ps(_mm256_loadu_ps(_d.pz + i), _mm256_mul_ps(dz, step));
+        __m256 ahead = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(tx, x), dx),
+                                                   _mm256_mul_ps(_mm256_sub_ps(ty, y), dy)),
+                                     _mm256_mul_ps(_mm256_sub_ps(tz, z), dz));
+        __m256 done = _mm256_cmp_ps(ahead, zero, _CMP_LE_OQ);
+        _mm256_storeu_ps(_d.px + i, _mm256_blendv_ps(x, tx, done));
+        _mm256_storeu_ps(_d.py + i, _mm256_blendv_ps(y, ty, done));
+        _mm256_storeu_ps(_d.pz + i, _mm256_blendv_ps(z, tz, done));
+        auto mask = static_cast<unsigned>(_mm256_movemask_ps(done));
+        for(size_t j = 0; j < 8; ++j)
+        {
+            _d.arrived[i + j] = static_cast<uint8_t>((mask >> j) & 1u);
+        }
+        arrivals += static_cast<size_t>(__builtin_popcount(mask));
+    }
+    return arrivals + advanceScalar(_d, _dt, i);
+}
+
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+size_t advanceAVX512(const ParticleStepData &_d, float _dt)
+{
+    size_t arrivals = 0;
+    const __m512 dt = _mm512_set1_ps(_dt);
+    const __m512 zero = _mm512_setzero_ps();
+    size_t i = 0;
+    for(; i + 16 <= _d.size; i += 16)
+    {
+        __m512 dx = _mm512_loadu_ps(_d.dx + i);
+        __m512 dy = _mm512_loadu_ps(_d.dy + i);
+        __m512 dz = _mm512_loadu_ps(_d.dz + i);
+        __m512 tx = _mm512_loadu_ps(_d.tx + i);
+        __m512 ty = _mm512_loadu_ps(_d.ty + i);
+        __m512 tz = _mm512_loadu_ps(_d.tz + i);
+        __m512 step = _mm512_mul_ps(_mm512_loadu_ps(_d.speed + i), dt);
+        __m512 x = _mm512_add_ps(_mm512_loadu_ps(_d.px + i), _mm512_mul_ps(dx, step));
+        __m512 y = _mm512_add_ps(_mm512_loadu_ps(_d.py + i), _mm512_mul_ps(dy, step));
+        __m512 z = _mm512_add_ps(_mm512_loadu_ps(_d.pz + i), _mm512_mul_ps(dz, step));
+        __m512 ahead = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_sub_ps(tx, x), dx),
+                                                   _mm512_mul_ps(_mm512_sub_ps(ty, y), dy)),
+                                     _mm512_mul_ps(_mm512_sub_ps(tz, z), dz));
+        __mmask16 done = _mm512_cmp_ps_mask(ahead, zero, _CMP_LE_OQ);
+        _mm512_storeu_ps(_d.px + i, _mm512_mask_blend_ps(done, x, tx));
+        _mm512_storeu_ps(_d.py + i, _mm512_mask_blend_ps(done, y, ty));
+        _mm512_storeu_ps(_d.pz + i, _mm512_mask_blend_ps(done, z, tz));
+        auto mask = static_cast<unsigned>(done);
+        for(size_t j = 0; j < 16; ++j)
+        {
+            _d.arrived[i + j] = static_cast<uint8_t>((mask >> j) & 1u);
+        }
+        arrivals += static_cast<size_t>(__builtin_popcount(mask));
+    }
+    return arrivals + advanceScalar(_d, _dt, i);
+}
+#endif
+
+// set from the ui thread while the pool workers read it mid step
+std::atomic<SimdLevel> g_level{detectSimdLevel()};
+
+} // end of anonymous namespace
+
+size_t advanceParticles(const ParticleStepData &_data, float _dt)
+{
+    return advanceParticles(_data, _dt, g_level.load(std::memory_order_acquire));
+}
+
+size_t advanceParticles(const ParticleStepData &_data, float _dt, SimdLevel _level)
+{
+    switch(_level)
+    {
+#ifdef DAS_X86_SIMD
+    case SimdLevel::AVX512: return advanceAVX512(_data, _dt);
+    case SimdLevel::AVX2: return advanceAVX2(_data, _dt);
+#endif
+    default: return advanceScalar(_data, _dt, 0);
+    }
+}
+
+SimdLevel detectSimdLevel()
+{
+#ifdef DAS_X86_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f"))
+    {
+        return SimdLevel::AVX512;
+    }
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return SimdLevel::AVX2;
+    }
+#endif
+    return SimdLevel::Scalar;
+}
+
+SimdLevel simdLevel()
+{
+    return g_level.load(std::memory_order_acquire);
+}
+
+void setSimdLevel(SimdLevel _level)
+{
+    // never hand out a kernel the cpu can't run
+    auto best = detectSimdLevel();
+    g_level.store((static_cast<int>(_level) > static_cast<int>(best)) ? best : _level, std::memory_order_release);
+}
+
+const char* simdLevelName(SimdLevel _level)
+{
+    switch(_level)
+    {
+    case SimdLevel::AVX512: return "avx512";
+    case SimdLevel::AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
@@ -0,0 +1,126 @@
+#include <cmath>
+#include <ngl/ShaderLib.h>
+#include <ngl/Util.h>
+#include "ParticleRenderer.h"
+
+ParticleRenderer::~ParticleRenderer()
+{
+    glDeleteVertexArrays(1, &m_sphereVAO);
+    glDeleteVertexArrays(1, &m_spriteVAO);
+    GLuint buffers[3] = {m_sphereBuffer, m_sphereIndices, m_instanceBuffer};
+    glDeleteBuffers(3, buffers);
+}
+
+void ParticleRenderer::init(float _radius)
+{
+    m_radius = _radius;
+    ngl::ShaderLib *shader = ngl::ShaderLib::instance();
+    shader->loadShader("particleShader", "shaders/particleVertex.glsl",
+                       "shaders/particleFragment.glsl");
+    shader->loadShader("particleSpriteShader", "shaders/particleSpriteVertex.glsl",
+                       "shaders/particleSpriteFragment.glsl");
+
+    // a low poly uv sphere, particles are only a few pixels across
+    const size_t rings = 8;
+    const size_t sectors = 12;
+    std::vector<ngl::Vec3> verts;
+    std::vector<uint32_t> indices;
+    for(size_t r = 0; r <= rings; ++r)
+    {
+        auto phi = static_cast<float>(M_PI) * r / rings;
+        for(size_t s = 0; s <= sectors; ++s)
+        {
+            auto theta = 2.0f * static_cast<float>(M_PI) * s / sectors;
+            verts.push_back(ngl::Vec3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta)) * _radius);
+        }
+    }
+    for(size_t r = 0; r < rings; ++r)
+    {
+        for(size_t s = 0; s < sectors; ++s)
+        {
+            auto a = static_cast<uint32_t>(r * (sectors + 1) + s);
+            auto b = static_cast<uint32_t>(a + sectors + 1);
+            indices.insert(indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+        }
+    }
+    m_numSphereIndices = static_cast<GLsizei>(indices.size());
+
+    glGenBuffers(1, &m_sphereBuffer);
+    glGenBuffers(1, &m_sphereIndices);
+    glGenBuffers(1, &m_instanceBuffer);
+    // spheres, mesh in attribute 0 and the particle in 1 and 2, advancing once per instance
+    glGenVertexArrays(1, &m_sphereVAO);
+    glBindVertexArray(m_sphereVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_sphereBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(verts.size() * sizeof(ngl::Vec3)), &verts[0].m_x, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ngl::Vec3), nullptr);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_sphereIndices);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(uint32_t)), indices.data(), GL_STATIC_DRAW);
+    bindInstanceAttributes(1, 2, 1);
+    // sprites, one point per particle straight from the same buffer
+    glGenVertexArrays(1, &m_spriteVAO);
+    glBindVertexArray(m_spriteVAO);
+    bindInstanceAttributes(0, 1, 0);
+    glBindVertexArray(0);
+}
+
+void ParticleRenderer::update(const std::vector<ngl::Vec3> &_pos, bool _colorByPosition, const ngl::Vec3 &_color)
+{
+    // interleaved position, colour
+    m_instances.resize(_pos.size() * 2);
+    for(size_t i = 0; i < _pos.size(); ++i)
+    {
+        m_instances[i * 2] = _pos[i];
+        m_instances[i * 2 + 1] = _colorByPosition ? _pos[i] : _color;
+    }
+    m_numInstances = static_cast<GLsizei>(_pos.size());
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    // orphan last frame's storage rather than waiting for the GPU to finish with it
+    auto bytes = static_cast<GLsizeiptr>(m_instances.size() * sizeof(ngl::Vec3));
+    glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    if(bytes > 0)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &m_instances[0].m_x);
+    }
+}
+
+void ParticleRenderer::draw(const ngl::Mat4 &_MVP, const ngl::Mat4 &_project, int _viewportHeight) const
+{
+    if(m_numInstances == 0)
+    {
+        return;
+    }
+    ngl::ShaderLib *shader = ngl::ShaderLib::instance();
+    if(usesSprites())
+    {
+        // a sprite covers the sphere's projected diameter, which shrinks with clip w
+        shader->use("particleSpriteShader");
+        shader->setUniform("MVP", _MVP);
+        shader->setUniform("spriteScale", m_radius * _project.m_11 * static_cast<float>(_viewportHeight));
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        glBindVertexArray(m_spriteVAO);
+        glDrawArrays(GL_POINTS, 0, m_numInstances);
+        glDisable(GL_PROGRAM_POINT_SIZE);
+    }
+    else
+    {
+        shader->use("particleShader");
+        shader->setUniform("MVP", _MVP);
+        glBindVertexArray(m_sphereVAO);
+        glDrawElementsInstanced(GL_TRIANGLES, m_numSphereIndices, GL_UNSIGNED_INT, nullptr, m_numInstances);
+    }
+    glBindVertexArray(0);
+}
+
+void ParticleRenderer::bindInstanceAttributes(GLuint _position, GLuint _color, GLuint _divisor) const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    glEnableVertexAttribArray(_position);
+    glVertexAttribPointer(_position, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(ngl::Vec3), nullptr);
+    glVertexAttribDivisor(_position, _divisor);
+    glEnableVertexAttribArray(_color);
+    glVertexAttribPointer(_color, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(ngl::Vec3),
+                          reinterpret_cast<const GLvoid*>(sizeof(ngl::Vec3)));
+    glVertexAttribDivisor(_color, _divisor);
+}
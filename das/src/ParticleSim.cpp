@@ -0,0 +1,520 @@
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <utility>
+#include "ParticleSim.h"
+#include "ParticleKernel.h"
+
+namespace
+{
+    // counter streams, keep draws for different purposes from ever sharing a counter
+    enum : uint32_t
+    {
+        StreamStart = 0,
+        StreamGoal = 1,
+        StreamGoalChance = 2
+    };
+    // next node of a particle that has reached the goal
+    const size_t Finished = std::numeric_limits<size_t>::max();
+}
+
+ParticleSim::ParticleSim() : m_rng(randomSeed())
+{
+}
+
+ParticleSim::ParticleSim(Graph _graph) : ParticleSim(std::move(_graph), randomSeed())
+{
+}
+
+ParticleSim::ParticleSim(Graph _graph, uint64_t _seed) : m_rng(_seed)
+{
+    setGraph(std::move(_graph));
+}
+
+void ParticleSim::step(float _dt)
+{
+    // goal change chance
+    if(m_isGoalRandom && m_rng.uniform(m_tick, StreamGoalChance) < 0.01f)
+    {
+        changeGoal();
+    }
+    // particle animations
+    m_time += _dt;
+    if(m_mode == Mode::EventDriven)
+    {
+        // nothing but arrivals changed, only compact if someone finished
+        if(processEvents() > 0)
+        {
+            prune();
+        }
+    }
+    else
+    {
+        animateParticles(_dt);
+        prune(); // cut off particles that have reached their goals
+    }
+    spawn(); // spawn in new particles up to m_numParticles
+    ++m_tick;
+}
+
+void ParticleSim::setMode(Mode _mode)
+{
+    if(_mode == m_mode)
+    {
+        return;
+    }
+    auto& ps = m_particles;
+    if(_mode == Mode::EventDriven)
+    {
+        // everyone departs from where they are now
+        ps.depart.assign(ps.size(), m_time);
+        ps.arrive.resize(ps.size());
+        m_mode = _mode;
+        for(size_t i = 0; i < ps.size(); ++i)
+        {
+            schedule(i);
+        }
+    }
+    else
+    {
+        // bake the interpolated positions back in
+        auto pos = positions();
+        for(size_t i = 0; i < ps.size(); ++i)
+        {
+            ps.px[i] = pos[i].m_x;
+            ps.py[i] = pos[i].m_y;
+            ps.pz[i] = pos[i].m_z;
+        }
+        m_events = decltype(m_events)();
+        m_mode = _mode;
+    }
+}
+
+void ParticleSim::setSeed(uint64_t _seed)
+{
+    m_rng = Philox(_seed);
+    reset();
+}
+
+void ParticleSim::setRecording(bool _isRecording)
+{
+    if(_isRecording && !m_isRecording)
+    {
+        // everyone alive starts a track from where they are now
+        auto& ps = m_particles;
+        for(size_t i = 0; i < ps.size(); ++i)
+        {
+            ps.track[i] = m_timeline.addTrack(recordPath(i), m_time, ps.speed[i]);
+        }
+    }
+    else if(!_isRecording && m_isRecording)
+    {
+        // cut everyone's trip off here, otherwise playback keeps following routes they may no longer take
+        auto& ps = m_particles;
+        for(size_t i = 0; i < ps.size(); ++i)
+        {
+            if(ps.next[i] != Finished)
+            {
+                m_timeline.endTrack(ps.track[i], m_time);
+            }
+        }
+        // the goal can change while we're not recording, so shared spawn paths can't be trusted afterwards
+        m_spawnPaths.clear();
+    }
+    m_isRecording = _isRecording;
+}
+
+void ParticleSim::setNumThreads(size_t _n)
+{
+    if(_n == numThreads())
+    {
+        return;
+    }
+    m_pool.reset(_n > 1 ? new ThreadPool(_n) : nullptr);
+}
+
+void ParticleSim::setGraph(Graph _graph)
+{
+    m_graph = std::move(_graph);
+    reset();
+}
+
+void ParticleSim::changeGoal()
+{
+    randomGoal();
+    resetParticleGoal();
+}
+
+void ParticleSim::reset()
+{
+    m_particles.clear();
+    m_tick = 0;
+    m_time = 0.0;
+    m_events = decltype(m_events)();
+    m_timeline.clear();
+    m_spawnPaths.clear();
+    m_nextId = 0;
+    m_goalDraws = 0;
+    randomGoal(); // get a goal for the new graph so goal is not out-of-index
+    spawn();
+}
+
+ngl::Vec3 ParticleSim::position(size_t _i) const
+{
+    auto& ps = m_particles;
+    ngl::Vec3 pos(ps.px[_i], ps.py[_i], ps.pz[_i]);
+    if(m_mode == Mode::EventDriven)
+    {
+        // travelled along dir since departure, never past the target
+        auto t = std::min(m_time, ps.arrive[_i]) - ps.depart[_i];
+        pos += ngl::Vec3(ps.dx[_i], ps.dy[_i], ps.dz[_i]) * (ps.speed[_i] * static_cast<float>(t));
+    }
+    return pos;
+}
+
+std::vector<ngl::Vec3> ParticleSim::positions() const
+{
+    std::vector<ngl::Vec3> pos;
+    positions(pos);
+    return pos;
+}
+
+void ParticleSim::positions(std::vector<ngl::Vec3> &_out) const
+{
+    _out.resize(m_particles.size());
+    parallelFor(_out.size(), 4096, [&](size_t _begin, size_t _end)
+    {
+        for(size_t i = _begin; i < _end; ++i)
+        {
+            _out[i] = position(i);
+        }
+    });
+}
+
+void ParticleSim::snapshot(FrameState &_frame)
+{
+    // revisions are unique across graphs, so this catches a new graph as well as an edit
+    if(!m_published || m_published->revision() != m_graph.revision())
+    {
+        m_published = std::make_shared<const Graph>(m_graph);
+    }
+    _frame.tick = m_tick;
+    _frame.time = m_time;
+    _frame.goal = m_goal;
+    _frame.graph = m_published;
+    positions(_frame.positions);
+}
+
+void ParticleSim::spawn()
+{
+    // nowhere the goal can be reached from, e.g. an empty or single node graph
+    if(m_starts.empty())
+    {
+        return;
+    }
+    // check list completeness
+    if(m_particles.size() < m_numParticles)
+    {
+        // starts only depend on the particle id, so they can be picked in parallel
+        auto first = m_particles.size();
+        auto toAdd = m_numParticles - first;
+        std::vector<size_t> starts(toAdd);
+        parallelFor(toAdd, 4096, [&](size_t _begin, size_t _end)
+        {
+            for(size_t i = _begin; i < _end; ++i)
+            {
+                starts[i] = randomStart(m_nextId + i);
+            }
+        });
+        // add particles, each sits on its start node and takes the first hop towards the goal
+        m_particles.reserve(m_numParticles);
+        for(size_t i = 0; i < toAdd; ++i)
+        {
+            m_particles.push_back(m_nextId + i, m_graph.pos(starts[i]), m_speed, starts[i]);
+            // starts can always reach the goal, so there is a first hop
+            nextHop(first + i);
+            if(m_mode == Mode::EventDriven)
+            {
+                m_particles.depart[first + i] = m_time;
+                schedule(first + i);
+            }
+            if(m_isRecording)
+            {
+                // particles starting from the same node share a path
+                auto key = (static_cast<uint64_t>(starts[i]) << 32) | m_goal;
+                auto found = m_spawnPaths.find(key);
+                auto path = (found != m_spawnPaths.end()) ? found->second : (m_spawnPaths[key] = recordPath(first + i));
+                m_particles.track[first + i] = m_timeline.addTrack(path, m_time, m_speed);
+            }
+        }
+        m_nextId += toAdd;
+    }
+}
+
+size_t ParticleSim::randomStart(uint64_t _id) const
+{
+    // pick from the nodes that can reach the goal, so no particle is stranded where it spawns
+    return m_starts[m_rng.index(m_starts.size(), _id, StreamStart)];
+}
+
+uint64_t ParticleSim::randomSeed()
+{
+    std::random_device rd;
+    auto now = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    return ((static_cast<uint64_t>(rd()) << 32) | rd()) ^ now;
+}
+
+void ParticleSim::animateParticles(float _dt)
+{
+    auto& ps = m_particles;
+    m_arrived.resize(ps.size());
+    parallelFor(ps.size(), 4096, [&](size_t _begin, size_t _end)
+    {
+        ParticleStepData data = {&ps.px[_begin], &ps.py[_begin], &ps.pz[_begin],
+                                 &ps.dx[_begin], &ps.dy[_begin], &ps.dz[_begin],
+                                 &ps.tx[_begin], &ps.ty[_begin], &ps.tz[_begin],
+                                 &ps.speed[_begin], &m_arrived[_begin], _end - _begin};
+        // move everyone, particles that reach their node are snapped onto it
+        if(advanceParticles(data, _dt) == 0)
+        {
+            return;
+        }
+        // point arrivals at the next node on the way to the goal
+        for(size_t i = _begin; i < _end; ++i)
+        {
+            if(m_arrived[i])
+            {
+                nextHop(i);
+            }
+        }
+    });
+}
+
+void ParticleSim::prune()
+{
+    // stable compaction, survivors slide down over finished particles in a single pass so
+    // retiring any number of particles is linear and keeps the particle order deterministic
+    auto& ps = m_particles;
+    size_t kept = 0;
+    for(size_t i = 0; i < ps.size(); ++i)
+    {
+        if(ps.next[i] != Finished)
+        {
+            if(kept != i)
+            {
+                ps.move(i, kept);
+            }
+            ++kept;
+        }
+    }
+    // shrinking keeps capacity, so respawning up to the cap doesn't allocate
+    ps.resize(kept);
+}
+
+void ParticleSim::resetParticleGoal()
+{
+    // nothing to search per particle, each finishes the step to its next node and then follows the new
+    // shared tree, only recorded trips need cutting over to the new route
+    if(!m_isRecording)
+    {
+        return;
+    }
+    auto& ps = m_particles;
+    for(size_t i = 0; i < ps.size(); ++i)
+    {
+        if(ps.next[i] == Finished)
+        {
+            continue;
+        }
+        // the old trip stops here and a new one carries on from the same spot
+        m_timeline.endTrack(ps.track[i], m_time);
+        ps.track[i] = m_timeline.addTrack(recordPath(i), m_time, ps.speed[i]);
+    }
+}
+
+void ParticleSim::parallelFor(size_t _n, size_t _grain, const std::function<void(size_t, size_t)> &_fn) const
+{
+    if(m_pool)
+    {
+        m_pool->parallelFor(_n, _grain, _fn);
+    }
+    else if(_n > 0)
+    {
+        _fn(0, _n);
+    }
+}
+
+size_t ParticleSim::processEvents()
+{
+    auto& ps = m_particles;
+    size_t finished = 0;
+    while(!m_events.empty() && m_events.top().time <= m_time)
+    {
+        auto e = m_events.top();
+        m_events.pop();
+        // particles stay sorted by id, prune only ever slides them down
+        auto it = std::lower_bound(ps.id.begin(), ps.id.end(), e.id);
+        if(it == ps.id.end() || *it != e.id)
+        {
+            continue;
+        }
+        auto i = static_cast<size_t>(it - ps.id.begin());
+        // snap onto the node and leave it at the exact arrival time, not at the end of the step
+        ps.px[i] = ps.tx[i];
+        ps.py[i] = ps.ty[i];
+        ps.pz[i] = ps.tz[i];
+        ps.depart[i] = e.time;
+        if(!nextHop(i))
+        {
+            ++finished;
+            continue;
+        }
+        schedule(i);
+    }
+    return finished;
+}
+
+void ParticleSim::schedule(size_t _i)
+{
+    auto& ps = m_particles;
+    auto distance = (ngl::Vec3(ps.tx[_i], ps.ty[_i], ps.tz[_i]) - ngl::Vec3(ps.px[_i], ps.py[_i], ps.pz[_i])).length();
+    ps.arrive[_i] = ps.depart[_i] + static_cast<double>(distance / ps.speed[_i]);
+    m_events.push(Event(ps.arrive[_i], ps.id[_i]));
+}
+
+size_t ParticleSim::recordPath(size_t _i)
+{
+    auto& ps = m_particles;
+    std::vector<ngl::Vec3> points;
+    points.push_back(position(_i));
+    // walk the shared tree from the next node to the goal
+    auto n = ps.next[_i];
+    points.push_back(m_graph.pos(n));
+    while(n != m_goal && m_towards[n] < m_graph.size())
+    {
+        n = m_towards[n];
+        points.push_back(m_graph.pos(n));
+    }
+    return m_timeline.addPath(points);
+}
+
+void ParticleSim::setTarget(size_t _i)
+{
+    auto& ps = m_particles;
+    auto target = m_graph.pos(ps.next[_i]);
+    auto direction = target - ngl::Vec3(ps.px[_i], ps.py[_i], ps.pz[_i]);
+    direction.normalize();
+    ps.tx[_i] = target.m_x;
+    ps.ty[_i] = target.m_y;
+    ps.tz[_i] = target.m_z;
+    ps.dx[_i] = direction.m_x;
+    ps.dy[_i] = direction.m_y;
+    ps.dz[_i] = direction.m_z;
+}
+
+bool ParticleSim::nextHop(size_t _i)
+{
+    auto& ps = m_particles;
+    auto at = ps.next[_i];
+    // done at the goal, or stuck on a node the goal can't be reached from
+    if(at == m_goal || m_towards[at] >= m_graph.size())
+    {
+        ps.next[_i] = Finished;
+        return false;
+    }
+    ps.next[_i] = m_towards[at];
+    setTarget(_i);
+    return true;
+}
+
+void ParticleSim::randomGoal()
+{
+    // removed nodes keep their ids, only draw from the ones still in use
+    std::vector<size_t> live;
+    live.reserve(m_graph.numNodes());
+    for(size_t n = 0; n < m_graph.size(); ++n)
+    {
+        if(m_graph.isNode(n))
+        {
+            live.push_back(n);
+        }
+    }
+    m_goal = live.empty() ? 0 : live[m_rng.index(live.size(), m_goalDraws++, StreamGoal)];
+    // one search out from the goal routes every particle, wherever it is
+    m_towards = m_graph.shortestPathTree(m_goal);
+    m_starts.clear();
+    for(size_t n = 0; n < m_towards.size(); ++n)
+    {
+        if(n != m_goal && m_towards[n] < m_graph.size())
+        {
+            m_starts.push_back(n);
+        }
+    }
+}
+
+void ParticleSim::Particles::clear()
+{
+    px.clear(); py.clear(); pz.clear();
+    dx.clear(); dy.clear(); dz.clear();
+    tx.clear(); ty.clear(); tz.clear();
+    speed.clear();
+    next.clear();
+    id.clear();
+    depart.clear();
+    arrive.clear();
+    track.clear();
+}
+
+void ParticleSim::Particles::reserve(size_t _n)
+{
+    px.reserve(_n); py.reserve(_n); pz.reserve(_n);
+    dx.reserve(_n); dy.reserve(_n); dz.reserve(_n);
+    tx.reserve(_n); ty.reserve(_n); tz.reserve(_n);
+    speed.reserve(_n);
+    next.reserve(_n);
+    id.reserve(_n);
+    depart.reserve(_n);
+    arrive.reserve(_n);
+    track.reserve(_n);
+}
+
+void ParticleSim::Particles::push_back(uint64_t _id, ngl::Vec3 _pos, float _speed, size_t _next)
+{
+    // direction and target are filled in by ParticleSim::setTarget
+    px.push_back(_pos.m_x); py.push_back(_pos.m_y); pz.push_back(_pos.m_z);
+    dx.push_back(0.0f); dy.push_back(0.0f); dz.push_back(0.0f);
+    tx.push_back(_pos.m_x); ty.push_back(_pos.m_y); tz.push_back(_pos.m_z);
+    speed.push_back(_speed);
+    next.push_back(_next);
+    id.push_back(_id);
+    depart.push_back(0.0);
+    arrive.push_back(0.0);
+    track.push_back(0);
+}
+
+void ParticleSim::Particles::move(size_t _from, size_t _to)
+{
+    px[_to] = px[_from]; py[_to] = py[_from]; pz[_to] = pz[_from];
+    dx[_to] = dx[_from]; dy[_to] = dy[_from]; dz[_to] = dz[_from];
+    tx[_to] = tx[_from]; ty[_to] = ty[_from]; tz[_to] = tz[_from];
+    speed[_to] = speed[_from];
+    next[_to] = next[_from];
+    id[_to] = id[_from];
+    depart[_to] = depart[_from];
+    arrive[_to] = arrive[_from];
+    track[_to] = track[_from];
+}
+
+void ParticleSim::Particles::resize(size_t _n)
+{
+    px.resize(_n); py.resize(_n); pz.resize(_n);
+    dx.resize(_n); dy.resize(_n); dz.resize(_n);
+    tx.resize(_n); ty.resize(_n); tz.resize(_n);
+    speed.resize(_n);
+    next.resize(_n);
+    id.resize(_n);
+    depart.resize(_n);
+    arrive.resize(_n);
+    track.resize(_n);
+}
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <chrono>
+#include "SimulationThread.h"
+
+constexpr size_t SimulationThread::NumBuckets;
+
+SimulationThread::SimulationThread(ParticleSim &_sim, TripleBuffer<FrameState> &_frames,
+                                   std::function<void()> _onFrame) :
+    m_sim(_sim), m_frames(_frames), m_onFrame(std::move(_onFrame))
+{
+    for(auto& b : m_histogram)
+    {
+        b = 0;
+    }
+}
+
+SimulationThread::~SimulationThread()
+{
+    stop();
+}
+
+void SimulationThread::start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_running)
+    {
+        return;
+    }
+    m_stop = false;
+    m_running = true;
+    m_thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop()
+{
+    if(!m_running)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+    // anything posted after the last tick still has to happen, under the lock so a post from another thread
+    // can't run at the same time
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+    if(!m_commands.empty())
+    {
+        runCommands(m_commands);
+        publish();
+    }
+}
+
+void SimulationThread::post(Command _command)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_running)
+    {
+        // stopped, holding the lock is enough to have the simulation to ourselves
+        _command(m_sim);
+        publish();
+        return;
+    }
+    m_commands.push_back(std::move(_command));
+}
+
+void SimulationThread::setTickRate(double _hz)
+{
+    if(_hz > 0.0)
+    {
+        m_tickRate = _hz;
+    }
+}
+
+std::array<uint64_t, SimulationThread::NumBuckets> SimulationThread::histogram() const
+{
+    std::array<uint64_t, NumBuckets> counts;
+    for(size_t b = 0; b < NumBuckets; ++b)
+    {
+        counts[b] = m_histogram[b];
+    }
+    return counts;
+}
+
+void SimulationThread::publish()
+{
+    m_sim.snapshot(m_frames.back());
+    m_frames.publish();
+    if(m_onFrame)
+    {
+        m_onFrame();
+    }
+}
+
+void SimulationThread::runCommands(std::vector<Command> &_commands)
+{
+    for(auto& c : _commands)
+    {
+        c(m_sim);
+    }
+    _commands.clear();
+}
+
+void SimulationThread::run()
+{
+    typedef std::chrono::steady_clock Clock;
+    auto last = Clock::now();
+    double accumulator = 0.0;
+    std::vector<Command> commands;
+    for(;;)
+    {
+        auto dt = 1.0 / m_tickRate;
+        {
+            // sleep until the next step is due, or we're told to stop
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto due = last + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(dt - accumulator));
+            m_wake.wait_until(lock, due, [&] { return m_stop; });
+            if(m_stop)
+            {
+                break;
+            }
+            commands.swap(m_commands);
+        }
+        runCommands(commands);
+        auto now = Clock::now();
+        accumulator += std::chrono::duration<double>(now - last).count();
+        last = now;
+        // whole steps only, so the simulation never sees the jitter
+        size_t steps = static_cast<size_t>(accumulator / dt);
+        if(steps == 0)
+        {
+            continue;
+        }
+        size_t maxSteps = m_maxCatchUp;
+        if(steps > maxSteps)
+        {
+            m_dropped += steps - maxSteps;
+            accumulator -= static_cast<double>(steps - maxSteps) * dt;
+            steps = maxSteps;
+        }
+        for(size_t s = 0; s < steps; ++s)
+        {
+            auto begin = Clock::now();
+            m_sim.step(static_cast<float>(dt));
+            auto micros = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - begin).count();
+            size_t bucket = 0;
+            while(micros > 0 && bucket + 1 < NumBuckets)
+            {
+                micros >>= 1;
+                ++bucket;
+            }
+            ++m_histogram[bucket];
+            ++m_ticks;
+            accumulator -= dt;
+        }
+        m_caughtUp += steps - 1;
+        publish();
+    }
+}
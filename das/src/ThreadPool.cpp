@@ -0,0 +1,146 @@
+#include <algorithm>
+#include "ThreadPool.h"
+
+namespace
+{
+    uint64_t pack(uint64_t _begin, uint64_t _end) { return _begin | (_end << 32); }
+    uint32_t lo(uint64_t _span) { return static_cast<uint32_t>(_span); }
+    uint32_t hi(uint64_t _span) { return static_cast<uint32_t>(_span >> 32); }
+}
+
+ThreadPool::ThreadPool(size_t _numThreads)
+{
+    _numThreads = std::max<size_t>(_numThreads, 1);
+    m_runs.reset(new ChunkRun[_numThreads]);
+    m_workers.reserve(_numThreads - 1);
+    for(size_t i = 1; i < _numThreads; ++i)
+    {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for(auto& w : m_workers)
+    {
+        w.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t _n, size_t _grain, const std::function<void(size_t, size_t)> &_fn)
+{
+    _grain = std::max<size_t>(_grain, 1);
+    size_t chunks = (_n + _grain - 1) / _grain;
+    // not worth waking anyone up
+    if(m_workers.empty() || chunks < 2)
+    {
+        for(size_t b = 0; b < _n; b += _grain)
+        {
+            _fn(b, std::min(_n, b + _grain));
+        }
+        return;
+    }
+    // deal each thread an even, contiguous run of chunks
+    auto threads = size();
+    for(size_t t = 0; t < threads; ++t)
+    {
+        m_runs[t].span.store(pack(chunks * t / threads, chunks * (t + 1) / threads), std::memory_order_relaxed);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &_fn;
+        m_n = _n;
+        m_grain = _grain;
+        m_working = m_workers.size();
+        ++m_generation;
+    }
+    m_wake.notify_all();
+    // the caller is thread 0
+    runChunks(0);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_finished.wait(lock, [this]{ return m_working == 0; });
+    m_job = nullptr;
+}
+
+void ThreadPool::workerLoop(size_t _id)
+{
+    uint64_t seen = 0;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&]{ return m_quit || m_generation != seen; });
+            if(m_quit)
+            {
+                return;
+            }
+            seen = m_generation;
+        }
+        runChunks(_id);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(--m_working == 0)
+        {
+            m_finished.notify_all();
+        }
+    }
+}
+
+void ThreadPool::runChunks(size_t _id)
+{
+    auto run = [this](uint32_t _chunk)
+    {
+        size_t begin = _chunk * m_grain;
+        (*m_job)(begin, std::min(m_n, begin + m_grain));
+    };
+    uint32_t chunk;
+    // own work first
+    while(popFront(_id, chunk))
+    {
+        run(chunk);
+    }
+    // then steal from everyone else, starting with the next thread along
+    auto threads = size();
+    for(size_t i = 1; i < threads; ++i)
+    {
+        auto victim = (_id + i) % threads;
+        while(popBack(victim, chunk))
+        {
+            run(chunk);
+        }
+    }
+}
+
+bool ThreadPool::popFront(size_t _id, uint32_t &_chunk)
+{
+    auto& span = m_runs[_id].span;
+    auto s = span.load(std::memory_order_acquire);
+    while(lo(s) < hi(s))
+    {
+        if(span.compare_exchange_weak(s, pack(lo(s) + 1, hi(s)), std::memory_order_acq_rel))
+        {
+            _chunk = lo(s);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::popBack(size_t _id, uint32_t &_chunk)
+{
+    auto& span = m_runs[_id].span;
+    auto s = span.load(std::memory_order_acquire);
+    while(lo(s) < hi(s))
+    {
+        if(span.compare_exchange_weak(s, pack(lo(s), hi(s) - 1), std::memory_order_acq_rel))
+        {
+            _chunk = hi(s) - 1;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include "Timeline.h"
+
+size_t Timeline::addPath(const std::vector<ngl::Vec3> &_points)
+{
+    m_paths.push_back(Path(m_points.size(), _points.size()));
+    float length = 0.0f;
+    for(size_t i = 0; i < _points.size(); ++i)
+    {
+        if(i > 0)
+        {
+            length += (_points[i] - _points[i - 1]).length();
+        }
+        m_points.push_back(_points[i]);
+        m_arcLength.push_back(length);
+    }
+    return m_paths.size() - 1;
+}
+
+size_t Timeline::addTrack(size_t _path, double _start, float _speed)
+{
+    auto lifetime = static_cast<double>(pathLength(_path) / _speed);
+    m_tracks.push_back(Track(_path, _start, _start + lifetime, _speed));
+    m_maxLifetime = std::max(m_maxLifetime, lifetime);
+    m_duration = std::max(m_duration, _start + lifetime);
+    return m_tracks.size() - 1;
+}
+
+void Timeline::endTrack(size_t _track, double _time)
+{
+    auto& t = m_tracks[_track];
+    t.end = std::max(t.start, std::min(t.end, _time));
+}
+
+void Timeline::clear()
+{
+    m_paths.clear();
+    m_points.clear();
+    m_arcLength.clear();
+    m_tracks.clear();
+    m_maxLifetime = 0.0;
+    m_duration = 0.0;
+}
+
+float Timeline::pathLength(size_t _path) const
+{
+    auto& p = m_paths[_path];
+    return (p.count > 0) ? m_arcLength[p.first + p.count - 1] : 0.0f;
+}
+
+ngl::Vec3 Timeline::evaluate(size_t _track, double _time) const
+{
+    auto& t = m_tracks[_track];
+    auto& p = m_paths[t.path];
+    auto first = m_arcLength.begin() + static_cast<long>(p.first);
+    auto last = first + static_cast<long>(p.count);
+    // distance travelled, clamped to the path
+    auto s = t.speed * static_cast<float>(std::max(0.0, _time - t.start));
+    if(s >= *(last - 1))
+    {
+        return m_points[p.first + p.count - 1];
+    }
+    // find the segment we're on and interpolate along it
+    auto k = static_cast<size_t>(std::upper_bound(first, last, s) - first) - 1;
+    auto i = p.first + k;
+    auto segment = m_arcLength[i + 1] - m_arcLength[i];
+    auto a = (segment > 0.0f) ? (s - m_arcLength[i]) / segment : 0.0f;
+    return m_points[i] + (m_points[i + 1] - m_points[i]) * a;
+}
+
+std::vector<size_t> Timeline::tracksAt(double _time) const
+{
+    // only tracks started in the last m_maxLifetime seconds can still be alive
+    auto byStart = [](const Track &_t, double _s) { return _t.start < _s; };
+    auto lo = std::lower_bound(m_tracks.begin(), m_tracks.end(), _time - m_maxLifetime, byStart);
+    std::vector<size_t> alive;
+    for(auto it = lo; it != m_tracks.end() && it->start <= _time; ++it)
+    {
+        if(_time < it->end)
+        {
+            alive.push_back(static_cast<size_t>(it - m_tracks.begin()));
+        }
+    }
+    return alive;
+}
+
+std::vector<ngl::Vec3> Timeline::positionsAt(double _time, ThreadPool *_pool) const
+{
+    auto alive = tracksAt(_time);
+    std::vector<ngl::Vec3> pos(alive.size());
+    auto eval = [&](size_t _begin, size_t _end)
+    {
+        for(size_t i = _begin; i < _end; ++i)
+        {
+            pos[i] = evaluate(alive[i], _time);
+        }
+    };
+    if(_pool)
+    {
+        _pool->parallelFor(alive.size(), 4096, eval);
+    }
+    else
+    {
+        eval(0, alive.size());
+    }
+    return pos;
+}
@@ -1,5 +1,6 @@
 TEMPLATE=subdirs
 SUBDIRS+=das/das.pro
 SUBDIRS+=test/test.pro
+SUBDIRS+=bench/bench.pro
 
 OTHER_FILES+= README.md
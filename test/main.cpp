@@ -1,11 +1,35 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <sstream>
 #include <vector>
 #include <gtest/gtest.h>
 #include <iostream>
 #include <ngl/Vec3.h>
 #include <ngl/NGLInit.h>
 
+#include "DynamicKdTree.h"
 #include "Graph.h"
+#include "GraphBuilder.h"
+#include "GraphVersions.h"
+#include "KdTree.h"
+#include "MeshFile.h"
+#include "MeshLoader.h"
+#include "ColorMesh.h"
 #include "ColorTeapot.h"
+#include "ParticleSim.h"
+#include "ParticleKernel.h"
+#include "SimulationThread.h"
+#include "ThreadPool.h"
+#include "Philox.h"
+#include "Timeline.h"
+#include "TripleBuffer.h"
 
 int main(int argc, char **argv)
 {
@@ -54,6 +78,36 @@ TEST(Graph, userctor)
     EXPECT_TRUE(oedges[4] == 9);
 }
 
+TEST(Graph, neighbours)
+{
+    // initialize graph
+    std::vector<ngl::Vec3> points;
+    points.reserve(16);
+    for(size_t i = 0; i < 4; ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            points.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    Graph g(points, 3);
+    // same edges as edges(), in the same order, with their weights
+    for(size_t n = 0; n < 16; ++n)
+    {
+        auto ids = g.edges(n);
+        auto range = g.neighbours(n);
+        ASSERT_TRUE(range.size() == ids.size());
+        for(size_t i = 0; i < ids.size(); ++i)
+        {
+            EXPECT_TRUE(range[i].n == ids[i]);
+            EXPECT_TRUE(FCompare(range[i].w, (g.pos(n) - g.pos(ids[i])).lengthSquared()));
+        }
+    }
+    // nothing for nodes that aren't there
+    EXPECT_TRUE(g.neighbours(16).empty());
+    EXPECT_TRUE(Graph().neighbours(0).empty());
+}
+
 TEST(Graph, removeEdge)
 {
     // initialize graph
@@ -92,6 +146,53 @@ TEST(Graph, render)
     EXPECT_TRUE(lines.size() == 112);
 }
 
+TEST(Graph, lines)
+{
+    // initialize graph
+    std::vector<ngl::Vec3> points;
+    points.reserve(16);
+    for(size_t i = 0; i < 4; ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            points.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    Graph g(points, 3);
+    // each edge once, half of render
+    EXPECT_TRUE(g.lineIndices().size() == 56);
+    EXPECT_TRUE(g.positions().size() == 16);
+    EXPECT_TRUE(g.positions()[5] == g.pos(5));
+    EXPECT_TRUE(g.revision() == g.baseRevision());
+    EXPECT_TRUE(g.linesChangedSince(g.revision()).empty());
+    // a removed edge collapses its own line and nothing else
+    auto before = g.lineIndices();
+    auto start = g.revision();
+    g.removeEdge(5, 6);
+    EXPECT_TRUE(g.revision() != start);
+    EXPECT_TRUE(g.baseRevision() == start);
+    auto changed = g.linesChangedSince(start);
+    ASSERT_TRUE(changed.size() == 1);
+    EXPECT_TRUE(changed[0].count == 1);
+    auto& after = g.lineIndices();
+    for(size_t l = 0; l < 28; ++l)
+    {
+        auto collapsed = (after[l * 2] == after[l * 2 + 1]);
+        EXPECT_TRUE(collapsed == (l == changed[0].first));
+        EXPECT_TRUE(after[l * 2] == before[l * 2]);
+        EXPECT_TRUE(collapsed || g.isEdge(after[l * 2], after[l * 2 + 1]));
+    }
+    // removing a missing edge changes nothing, later edits are reported on their own
+    auto mid = g.revision();
+    g.removeEdge(5, 6);
+    EXPECT_TRUE(g.revision() == mid);
+    g.removeEdge(0, 5);
+    EXPECT_TRUE(g.linesChangedSince(mid).size() == 1);
+    // a new graph is a new layout
+    Graph g2(points, 3);
+    EXPECT_TRUE(g2.baseRevision() > g.revision());
+}
+
 TEST(Graph, Astar)
 {
     // initialize graph
@@ -127,6 +228,394 @@ TEST(Graph, Astar)
     EXPECT_TRUE(path2[4] == ngl::Vec3(3.0f, 3.0f, 0.0f));
 }
 
+TEST(Graph, shortestPathTree)
+{
+    // initialize graph
+    std::vector<ngl::Vec3> points;
+    points.reserve(16);
+    for(size_t i = 0; i < 4; ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            points.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    Graph g(points, 3);
+    // follow the tree home from every node, each hop must be an edge. Returns the cost, edges weigh their squared length
+    auto costHome = [&](const std::vector<size_t> &_next, size_t _n)
+    {
+        float cost = 0.0f;
+        for(size_t hops = 0; _n != 15 && hops < 16; ++hops)
+        {
+            EXPECT_TRUE(g.isEdge(_n, _next[_n]));
+            cost += (g.pos(_next[_n]) - g.pos(_n)).lengthSquared();
+            _n = _next[_n];
+        }
+        EXPECT_TRUE(_n == 15);
+        return cost;
+    };
+    auto next = g.shortestPathTree(15);
+    EXPECT_TRUE(next.size() == 16);
+    EXPECT_TRUE(next[15] == 15);
+    for(size_t n = 0; n < 16; ++n)
+    {
+        costHome(next, n);
+    }
+    EXPECT_TRUE(FCompare(costHome(next, 0), 6.0f));
+    // cut the diagonal through the middle, going round the edge costs the same
+    g.removeEdge(10, 15);
+    g.removeEdge(10, 14);
+    g.removeEdge(10, 11);
+    auto next2 = g.shortestPathTree(15);
+    EXPECT_TRUE(FCompare(costHome(next2, 0), 6.0f));
+    EXPECT_TRUE(FCompare(costHome(next2, 10), 4.0f));
+    // cut a node off completely, it has nowhere to go
+    for(auto e : g.edges(0))
+    {
+        g.removeEdge(0, e);
+    }
+    auto next3 = g.shortestPathTree(15);
+    EXPECT_TRUE(next3[0] == g.size());
+}
+
+TEST(Graph, nodeLookup)
+{
+    // initialize graph
+    std::vector<ngl::Vec3> points;
+    points.reserve(16);
+    for(size_t i = 0; i < 4; ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            points.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    Graph g(points, 3);
+    // exact and nearly exact positions find their node, anything else doesn't
+    for(size_t n = 0; n < 16; ++n)
+    {
+        EXPECT_TRUE(g.node(g.pos(n)) == n);
+        EXPECT_TRUE(g.node(g.pos(n) + ngl::Vec3(0.0001f, 0.0f, -0.0001f)) == n);
+    }
+    EXPECT_TRUE(g.node(ngl::Vec3(1.5f, 1.5f, 0.0f)) == 16);
+    EXPECT_TRUE(g.node(ngl::Vec3(-0.0f, 0.0f, 0.0f)) == 0);
+    // any position snaps to the closest node
+    EXPECT_TRUE(g.nearestNode(ngl::Vec3(2.2f, 0.9f, 5.0f)) == 9);
+    EXPECT_TRUE(g.nearestNode(ngl::Vec3(-3.0f, 10.0f, 0.0f)) == 3);
+    std::vector<ngl::Vec3> colours = {ngl::Vec3(0.4f, 0.4f, 0.0f), ngl::Vec3(3.0f, 2.6f, 1.0f)};
+    auto snapped = g.nearestNodes(colours);
+    EXPECT_TRUE(snapped.size() == 2);
+    EXPECT_TRUE(snapped[0] == 0);
+    EXPECT_TRUE(snapped[1] == 15);
+    // empty graph has nothing to find
+    Graph empty;
+    EXPECT_TRUE(empty.node(ngl::Vec3(0.0f)) == 0);
+    EXPECT_TRUE(empty.nearestNode(ngl::Vec3(0.0f)) == 0);
+}
+
+TEST(Graph, dynamicNodes)
+{
+    // initialize graph
+    std::vector<ngl::Vec3> points;
+    points.reserve(16);
+    for(size_t i = 0; i < 4; ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            points.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    Graph g(points, 3);
+    auto lines = g.lineIndices().size();
+    auto removed = g.neighbours(5).size();
+    EXPECT_TRUE(removed == 5);
+    // removing a node takes its edges with it, every other id stays put
+    g.removeNode(5);
+    EXPECT_FALSE(g.isNode(5));
+    EXPECT_TRUE(g.size() == 16);
+    EXPECT_TRUE(g.numNodes() == 15);
+    EXPECT_TRUE(g.neighbours(5).empty());
+    for(size_t n = 0; n < 16; ++n)
+    {
+        EXPECT_FALSE(g.isEdge(n, 5));
+        EXPECT_TRUE(n == 5 || g.node(points[n]) == n);
+    }
+    EXPECT_TRUE(g.node(points[5]) == 16);
+    EXPECT_TRUE(g.nearestNode(points[5]) != 5);
+    EXPECT_TRUE(g.lineIndices().size() == lines);
+    // adding takes the removed id back and joins it to its nearest nodes both ways
+    auto base = g.baseRevision();
+    EXPECT_TRUE(g.addNode(ngl::Vec3(1.1f, 1.0f, 0.0f)) == 5);
+    EXPECT_TRUE(g.isNode(5));
+    EXPECT_TRUE(g.numNodes() == 16);
+    EXPECT_TRUE(g.pos(5) == ngl::Vec3(1.1f, 1.0f, 0.0f));
+    EXPECT_TRUE(g.node(ngl::Vec3(1.1f, 1.0f, 0.0f)) == 5);
+    EXPECT_TRUE(g.neighbours(5).size() == 3);
+    EXPECT_TRUE(g.isEdge(5, 9) && g.isEdge(9, 5));
+    EXPECT_TRUE(g.baseRevision() != base);
+    // the renderer starts again from the new base, so the edits from before it are dropped
+    EXPECT_TRUE(g.linesChangedSince(0).size() == g.linesChangedSince(g.baseRevision()).size());
+    // its edges took over the removed lines
+    EXPECT_TRUE(g.lineIndices().size() == lines);
+    // with no ids to reuse the graph grows, and so do the lines once the last removed one is taken
+    EXPECT_TRUE(g.addNode(ngl::Vec3(4.0f, 4.0f, 0.0f), 3) == 16);
+    EXPECT_TRUE(g.size() == 17);
+    EXPECT_TRUE(g.edges(16) == std::vector<size_t>({15, 11, 14}));
+    EXPECT_TRUE(g.aStarNodes(0, 16).back() == 16);
+    EXPECT_TRUE(g.lineIndices().size() == lines + 2);
+    EXPECT_TRUE(g.linesChangedSince(0).empty());
+    // edges can be added between any two nodes, once
+    EXPECT_FALSE(g.isEdge(0, 15));
+    auto degree = g.edges(0).size();
+    g.addEdge(0, 15);
+    g.addEdge(15, 0);
+    EXPECT_TRUE(g.isEdge(0, 15) && g.isEdge(15, 0));
+    EXPECT_TRUE(g.edges(0).size() == degree + 1);
+    auto rev = g.revision();
+    g.removeEdge(0, 15);
+    EXPECT_TRUE(g.linesChangedSince(rev).size() == 1);
+    g.addEdge(0, 5);
+    g.addEdge(0, 0);
+    g.addEdge(0, 99);
+    EXPECT_TRUE(g.isEdge(0, 5) && !g.isEdge(0, 0));
+    // a copy shares everything but the blocks its edits touch
+    Graph copy = g;
+    copy.removeNode(16);
+    EXPECT_TRUE(g.isNode(16) && !copy.isNode(16));
+    EXPECT_TRUE(copy.sharedBlocks(g) == 0);
+
+    // lots of random edits, lookups must match checking every live node
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> unit(0.0f, 4.0f);
+    for(size_t i = 0; i < 400; ++i)
+    {
+        if(gen() % 3 == 0 && g.numNodes() > 4)
+        {
+            size_t n;
+            do
+            {
+                n = gen() % g.size();
+            }
+            while(!g.isNode(n));
+            g.removeNode(n);
+        }
+        else
+        {
+            g.addNode(ngl::Vec3(unit(gen), unit(gen), 0.0f));
+        }
+        ngl::Vec3 pos(unit(gen), unit(gen), 0.0f);
+        size_t best = g.size();
+        for(size_t n = 0; n < g.size(); ++n)
+        {
+            if(g.isNode(n) && (best == g.size() || (g.pos(n) - pos).lengthSquared() < (g.pos(best) - pos).lengthSquared()))
+            {
+                best = n;
+            }
+        }
+        EXPECT_TRUE(g.nearestNode(pos) == best);
+    }
+    for(size_t n = 0; n < g.size(); ++n)
+    {
+        for(auto& e : g.neighbours(n))
+        {
+            EXPECT_TRUE(g.isNode(e.n) && g.isEdge(e.n, n));
+        }
+    }
+}
+
+TEST(GraphBuilder, background)
+{
+    // allocate initializer list
+    std::vector<ngl::Vec3> points;
+    points.reserve(16);
+    for(size_t i = 0; i < 4; ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            points.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    std::mutex mutex;
+    std::vector<float> progress;
+    std::vector<Graph> built;
+    GraphBuilder builder([&](float _done) { std::lock_guard<std::mutex> lock(mutex); progress.push_back(_done); },
+                         [&](Graph _graph) { std::lock_guard<std::mutex> lock(mutex); built.push_back(_graph); });
+    EXPECT_FALSE(builder.isBuilding());
+    builder.build([&](const GraphBuilder::Progress &_progress) { return Graph(points, 3, _progress); });
+    builder.wait();
+    EXPECT_FALSE(builder.isBuilding());
+    ASSERT_TRUE(built.size() == 1);
+    EXPECT_TRUE(built[0].size() == 16);
+    EXPECT_TRUE(built[0].lineIndices() == Graph(points, 3).lineIndices());
+    // progress only goes up and finishes
+    EXPECT_TRUE(progress.size() > 1);
+    EXPECT_TRUE(std::is_sorted(progress.begin(), progress.end()));
+    EXPECT_TRUE(progress.back() == 1.0f);
+
+    // requests made while a build runs: that build and any waiting request give way to the newest
+    built.clear();
+    std::atomic<bool> started{false};
+    std::atomic<bool> release{false};
+    builder.build([&](const GraphBuilder::Progress &)
+    {
+        started = true;
+        while(!release)
+        {
+            std::this_thread::yield();
+        }
+        return Graph(points, 1);
+    });
+    while(!started)
+    {
+        std::this_thread::yield();
+    }
+    builder.build([&](const GraphBuilder::Progress &) { return Graph(points, 2); });
+    builder.build([&](const GraphBuilder::Progress &) { return Graph(points, 4); });
+    EXPECT_TRUE(builder.isBuilding());
+    release = true;
+    builder.wait();
+    ASSERT_TRUE(built.size() == 1);
+    EXPECT_TRUE(built[0].degree() == 4);
+
+    // a build that's been superseded stops linking at its next report instead of running to the end
+    built.clear();
+    std::vector<float> reports;
+    started = false;
+    release = false;
+    auto stalled = [&](const GraphBuilder::Progress &_progress)
+    {
+        return Graph(points, 3, [&](float _done)
+        {
+            reports.push_back(_done);
+            started = true;
+            while(!release)
+            {
+                std::this_thread::yield();
+            }
+            return _progress(_done);
+        });
+    };
+    builder.build(stalled);
+    while(!started)
+    {
+        std::this_thread::yield();
+    }
+    builder.build([&](const GraphBuilder::Progress &) { return Graph(points, 2); });
+    release = true;
+    builder.wait();
+    EXPECT_TRUE(reports.size() == 1);
+    ASSERT_TRUE(built.size() == 1);
+    EXPECT_TRUE(built[0].degree() == 2);
+    // and so does one still running when the builder goes away
+    reports.clear();
+    started = false;
+    release = false;
+    std::thread letGo;
+    {
+        GraphBuilder doomed(nullptr, [&](Graph _graph) { built.push_back(_graph); });
+        doomed.build(stalled);
+        while(!started)
+        {
+            std::this_thread::yield();
+        }
+        letGo = std::thread([&]
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            release = true;
+        });
+    }
+    letGo.join();
+    EXPECT_TRUE(reports.size() == 1);
+    EXPECT_TRUE(built.size() == 1);
+    // a job told to stop leaves nothing behind
+    EXPECT_TRUE(Graph(points, 3, [](float) { return false; }).size() == 0);
+}
+
+TEST(GraphVersions, snapshots)
+{
+    // allocate initializer list, big enough for a few blocks of nodes
+    std::vector<ngl::Vec3> points;
+    points.reserve(144);
+    for(size_t i = 0; i < 12; ++i)
+    {
+        for(size_t j = 0; j < 12; ++j)
+        {
+            points.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    Graph g(points, 3);
+    // a copy shares everything until it's edited, then only the edited block is its own
+    Graph copy = g;
+    EXPECT_TRUE(copy.sharedBlocks(g) == 3);
+    copy.removeEdge(0, 1);
+    EXPECT_TRUE(copy.sharedBlocks(g) == 2);
+    EXPECT_TRUE(g.isEdge(0, 1));
+    EXPECT_FALSE(copy.isEdge(0, 1));
+    EXPECT_TRUE(g.linesChangedSince(g.revision()).empty());
+
+    GraphVersions versions(g);
+    EXPECT_TRUE(versions.version() == 0);
+    {
+        auto before = versions.read();
+        EXPECT_TRUE(versions.edit([](Graph &_graph) { _graph.removeEdge(0, 1); }) == 1);
+        // the old version is untouched and kept while it's held
+        EXPECT_TRUE(before.version() == 0);
+        EXPECT_TRUE(before->isEdge(0, 1));
+        auto after = versions.read();
+        EXPECT_TRUE(after.version() == 1);
+        EXPECT_FALSE(after->isEdge(0, 1));
+        EXPECT_TRUE(after->sharedBlocks(*before) == 2);
+        EXPECT_TRUE(versions.retired() == 1);
+    }
+    versions.reclaim();
+    EXPECT_TRUE(versions.retired() == 0);
+
+    // readers on other threads always see a whole version: version v has exactly v edges removed
+    std::vector<std::pair<size_t, size_t>> remove;
+    for(size_t n = 0; n < g.size() && remove.size() < 20; n += 7)
+    {
+        remove.push_back(std::make_pair(n, g.edges(n)[0]));
+    }
+    versions.publish(g);
+    auto base = versions.version();
+    std::atomic<bool> done{false};
+    std::atomic<size_t> bad{0};
+    std::vector<std::thread> readers;
+    for(size_t t = 0; t < 3; ++t)
+    {
+        readers.emplace_back([&]
+        {
+            while(!done)
+            {
+                auto snap = versions.read();
+                size_t removed = 0;
+                for(auto& r : remove)
+                {
+                    removed += (snap->isEdge(r.first, r.second) || snap->isEdge(r.second, r.first)) ? 0 : 1;
+                }
+                if(removed != snap.version() - base)
+                {
+                    ++bad;
+                }
+            }
+        });
+    }
+    for(auto& r : remove)
+    {
+        versions.edit([&](Graph &_graph) { _graph.removeEdge(r.first, r.second); });
+        std::this_thread::yield();
+    }
+    done = true;
+    for(auto& t : readers)
+    {
+        t.join();
+    }
+    EXPECT_TRUE(bad == 0);
+    EXPECT_TRUE(versions.version() == base + remove.size());
+    versions.reclaim();
+    EXPECT_TRUE(versions.retired() == 0);
+}
+
 TEST(ColorTeapot, defaultctor)
 {
     ColorTeapot ct;
@@ -143,3 +632,917 @@ TEST(ColorTeapot, render)
     auto renderlist = ct.render(colors);
     EXPECT_TRUE(renderlist.size() == 5346*2*3);
 }
+
+TEST(ColorTeapot, colors)
+{
+    ColorTeapot ct;
+    // welded, far fewer vertices than corners and each of them used
+    EXPECT_TRUE(ct.indices().size() == 5346 * 3);
+    EXPECT_TRUE(ct.vertices().size() < 5346 * 3);
+    std::vector<bool> used(ct.vertices().size(), false);
+    for(auto i : ct.indices())
+    {
+        ASSERT_TRUE(i < ct.vertices().size());
+        used[i] = true;
+    }
+    EXPECT_TRUE(std::find(used.begin(), used.end(), false) == used.end());
+    std::vector<ngl::Vec3> colors;
+    colors.push_back(ngl::Vec3(0.0f));
+    colors.push_back(ngl::Vec3(1.0f));
+    colors.push_back(ngl::Vec3(1.0f, 0.0f, 1.0f));
+    // same colours render interleaves with the vertices
+    std::vector<ngl::Vec3> out;
+    ct.colors(colors, out);
+    auto renderlist = ct.render(colors);
+    ASSERT_TRUE(out.size() == ct.vertices().size());
+    for(size_t i = 0; i < ct.indices().size(); ++i)
+    {
+        EXPECT_TRUE(renderlist[i * 2] == ct.vertices()[ct.indices()[i]]);
+        EXPECT_TRUE(renderlist[i * 2 + 1] == out[ct.indices()[i]]);
+    }
+}
+
+TEST(ColorTeapot, meshFile)
+{
+    // the shipped asset is the same mesh as the built in teapot
+    ColorTeapot embedded;
+    ASSERT_TRUE(embedded.loadEmbedded());
+    ColorTeapot loaded(ColorTeapot::DefaultMesh);
+    ASSERT_TRUE(loaded.vertices().size() == embedded.vertices().size());
+    EXPECT_TRUE(loaded.indices() == embedded.indices());
+    for(size_t i = 0; i < loaded.vertices().size(); ++i)
+    {
+        EXPECT_TRUE(loaded.vertices()[i] == embedded.vertices()[i]);
+    }
+    // round trip through a new file
+    std::string path = testing::TempDir() + "roundtrip.dasm";
+    EXPECT_TRUE(embedded.save(path));
+    MeshFile file(path);
+    EXPECT_TRUE(file.isOpen());
+    EXPECT_TRUE(file.hasNormals());
+    EXPECT_TRUE(file.numVertices() == embedded.vertices().size());
+    EXPECT_TRUE(file.numIndices() == 5346 * 3);
+    EXPECT_TRUE(file.positions()[3] == embedded.vertices()[1].m_x);
+    // anything else is turned away and leaves the mesh empty
+    std::vector<ngl::Vec3> tri = {ngl::Vec3(0.0f), ngl::Vec3(1.0f, 0.0f, 0.0f), ngl::Vec3(0.0f, 1.0f, 0.0f)};
+    EXPECT_TRUE(MeshFile::write(path, tri, {}, {0, 1, 3}));
+    EXPECT_FALSE(loaded.load(path));
+    EXPECT_TRUE(loaded.numTris() == 0);
+    EXPECT_TRUE(MeshFile::write(path, tri, {}, {0, 1, 2}));
+    EXPECT_TRUE(loaded.load(path));
+    EXPECT_TRUE(loaded.numTris() == 3);
+    EXPECT_FALSE(loaded.load(testing::TempDir() + "missing.dasm"));
+    std::string text = testing::TempDir() + "notamesh.dasm";
+    std::ofstream(text) << "not a mesh, but long enough to have a header\n";
+    EXPECT_FALSE(MeshFile(text).isOpen());
+    std::remove(text.c_str());
+    std::remove(path.c_str());
+}
+
+TEST(MeshLoader, objPly)
+{
+    std::vector<ngl::Vec3> verts;
+    std::vector<uint32_t> idx;
+    // a quad and a triangle using relative indices, everything after the first / is ignored
+    std::istringstream obj("# comment\nv 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvn 0 0 1\n"
+                           "f 1/1/1 2/2/1 3/3/1 4/4/1\nf -4//1 -2//1 -1//1\n");
+    EXPECT_TRUE(MeshLoader::loadObj(obj, verts, idx));
+    EXPECT_TRUE(verts.size() == 4);
+    EXPECT_TRUE(verts[2] == ngl::Vec3(1.0f, 1.0f, 0.0f));
+    EXPECT_TRUE(idx == std::vector<uint32_t>({0, 1, 2, 0, 2, 3, 0, 2, 3}));
+    std::istringstream badObj("v 0 0 0\nf 1 2 3\n");
+    EXPECT_FALSE(MeshLoader::loadObj(badObj, verts, idx));
+    EXPECT_TRUE(verts.empty() && idx.empty());
+
+    // ascii PLY with an extra vertex property and an extra element to skip
+    std::istringstream ply("ply\nformat ascii 1.0\nelement vertex 4\nproperty float x\nproperty float y\n"
+                           "property float z\nproperty uchar red\nelement face 1\n"
+                           "property list uchar int vertex_indices\nelement edge 1\nproperty int vertex1\n"
+                           "property int vertex2\nend_header\n0 0 0 255\n1 0 0 0\n1 1 0 0\n0 1 0 0\n4 0 1 2 3\n0 1\n");
+    EXPECT_TRUE(MeshLoader::loadPly(ply, verts, idx));
+    EXPECT_TRUE(verts.size() == 4);
+    EXPECT_TRUE(verts[3] == ngl::Vec3(0.0f, 1.0f, 0.0f));
+    EXPECT_TRUE(idx == std::vector<uint32_t>({0, 1, 2, 0, 2, 3}));
+
+    // same quad in binary with double positions and ushort indices
+    std::string bin = "ply\nformat binary_little_endian 1.0\nelement vertex 4\nproperty double x\n"
+                      "property double y\nproperty double z\nelement face 1\n"
+                      "property list uchar ushort vertex_indices\nend_header\n";
+    double xyz[12] = {0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0};
+    bin.append(reinterpret_cast<const char*>(xyz), sizeof(xyz));
+    uint8_t count = 4;
+    uint16_t corners[4] = {0, 1, 2, 3};
+    bin.append(reinterpret_cast<const char*>(&count), 1);
+    bin.append(reinterpret_cast<const char*>(corners), sizeof(corners));
+    std::istringstream binPly(bin);
+    EXPECT_TRUE(MeshLoader::loadPly(binPly, verts, idx));
+    EXPECT_TRUE(verts.size() == 4);
+    EXPECT_TRUE(verts[1] == ngl::Vec3(1.0f, 0.0f, 0.0f));
+    EXPECT_TRUE(idx == std::vector<uint32_t>({0, 1, 2, 0, 2, 3}));
+    // cut short
+    std::istringstream shortPly(bin.substr(0, bin.size() - 2));
+    EXPECT_FALSE(MeshLoader::loadPly(shortPly, verts, idx));
+    std::istringstream bigEndian("ply\nformat binary_big_endian 1.0\nend_header\n");
+    EXPECT_FALSE(MeshLoader::loadPly(bigEndian, verts, idx));
+    // headers and lists that claim more than the file holds fail rather than allocating it
+    std::istringstream hugeCount("ply\nformat ascii 1.0\nelement vertex 100000000000\nproperty float x\n"
+                                 "property float y\nproperty float z\nend_header\n0 0 0\n");
+    EXPECT_FALSE(MeshLoader::loadPly(hugeCount, verts, idx));
+    EXPECT_TRUE(verts.empty() && idx.empty());
+    std::string quad = "ply\nformat ascii 1.0\nelement vertex 3\nproperty float x\nproperty float y\n"
+                       "property float z\nelement face 1\nproperty list uchar int vertex_indices\nend_header\n"
+                       "0 0 0\n1 0 0\n0 1 0\n";
+    std::istringstream hugeList(quad + "1e300 0 1 2\n");
+    EXPECT_FALSE(MeshLoader::loadPly(hugeList, verts, idx));
+    std::istringstream plyWrap(quad + "3 4294967296 1 2\n");
+    EXPECT_FALSE(MeshLoader::loadPly(plyWrap, verts, idx));
+    std::istringstream plyOk(quad + "3 0 1 2\n");
+    EXPECT_TRUE(MeshLoader::loadPly(plyOk, verts, idx));
+    // 2^32 + 1 would wrap round to the first vertex if narrowed before checking
+    std::istringstream objWrap("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 4294967297 2 3\n");
+    EXPECT_FALSE(MeshLoader::loadObj(objWrap, verts, idx));
+    EXPECT_TRUE(verts.empty() && idx.empty());
+    std::string text = testing::TempDir() + "notamesh.txt";
+    std::ofstream(text) << "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+    EXPECT_FALSE(MeshLoader::load(text, verts, idx));
+    std::remove(text.c_str());
+}
+
+TEST(ColorMesh, colors)
+{
+    // load the teapot through the extension switch
+    ColorMesh mesh(ColorTeapot::DefaultMesh);
+    ColorTeapot teapot;
+    EXPECT_FALSE(mesh.empty());
+    EXPECT_TRUE(mesh.numVertices() == teapot.vertices().size());
+    EXPECT_TRUE(mesh.indices() == teapot.indices());
+    // chunked, threaded colours match the teapot's serial ones
+    std::vector<ngl::Vec3> palette;
+    for(size_t i = 0; i < 7; ++i)
+    {
+        palette.push_back(ngl::Vec3(float(i), 0.0f, 1.0f));
+    }
+    std::vector<ngl::Vec3> expected;
+    teapot.colors(palette, expected);
+    ThreadPool pool(4);
+    for(size_t chunk : {1, 100, 1000000})
+    {
+        mesh.setChunkSize(chunk);
+        for(auto p : {static_cast<ThreadPool*>(nullptr), &pool})
+        {
+            std::vector<ngl::Vec3> out(mesh.numVertices());
+            mesh.colors(palette, out.data(), p);
+            EXPECT_TRUE(out == expected);
+        }
+    }
+    EXPECT_FALSE(mesh.load("missing.obj"));
+    EXPECT_TRUE(mesh.empty());
+}
+
+TEST(ColorMesh, nearestMapping)
+{
+    // a flat 4x4 grid mesh and two particles at opposite corners of their own space
+    std::vector<ngl::Vec3> verts;
+    for(size_t i = 0; i < 4; ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            verts.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    ColorMesh mesh;
+    mesh.setMesh(verts, {0, 1, 4});
+    std::vector<ngl::Vec3> particles = {ngl::Vec3(10.0f, 10.0f, 5.0f), ngl::Vec3(12.0f, 12.0f, 5.0f)};
+    std::vector<ngl::Vec3> colors = {ngl::Vec3(1.0f, 0.0f, 0.0f), ngl::Vec3(0.0f, 0.0f, 1.0f)};
+    std::vector<ngl::Vec3> out(verts.size());
+    // repeat is the default
+    mesh.mapColors(particles, colors, out.data());
+    EXPECT_TRUE(out[2] == colors[0] && out[3] == colors[1]);
+    // nearest splits the grid along its diagonal, vertices on it are a rounding error from either
+    mesh.setMapping(ColorMesh::Mapping::Nearest);
+    mesh.mapColors(particles, colors, out.data());
+    for(size_t i = 0; i < verts.size(); ++i)
+    {
+        auto v = verts[i];
+        if(v.m_x + v.m_y != 3.0f)
+        {
+            EXPECT_TRUE(out[i] == ((v.m_x + v.m_y < 3.0f) ? colors[0] : colors[1]));
+        }
+    }
+    // a blend of both, weighted towards the closer
+    mesh.setMapping(ColorMesh::Mapping::Blend);
+    mesh.setBlendCount(2);
+    mesh.mapColors(particles, colors, out.data());
+    EXPECT_TRUE(out[0] == colors[0]);
+    EXPECT_TRUE(out[15] == colors[1]);
+    EXPECT_TRUE(out[3] == ngl::Vec3(0.5f, 0.0f, 0.5f));
+    EXPECT_TRUE(out[1].m_x > out[1].m_z);
+    // fixed bounds put both particles in the bottom corner
+    mesh.setParticleBounds({ngl::Vec3(10.0f), ngl::Vec3(100.0f)});
+    mesh.setMapping(ColorMesh::Mapping::Nearest);
+    mesh.mapColors(particles, colors, out.data());
+    EXPECT_TRUE(out[15] == colors[1]);
+    EXPECT_TRUE(out[0] == colors[0]);
+
+    // threaded matches serial on the teapot with lots of particles
+    ColorTeapot teapot;
+    mesh.setMesh(teapot.vertices(), teapot.indices());
+    mesh.setParticleBounds({});
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    particles.resize(1000);
+    for(auto& p : particles)
+    {
+        p = ngl::Vec3(unit(gen), unit(gen), unit(gen));
+    }
+    ThreadPool pool(4);
+    for(auto mapping : {ColorMesh::Mapping::Nearest, ColorMesh::Mapping::Blend})
+    {
+        mesh.setMapping(mapping);
+        std::vector<ngl::Vec3> serial(mesh.numVertices());
+        std::vector<ngl::Vec3> threaded(mesh.numVertices());
+        mesh.mapColors(particles, particles, serial.data());
+        mesh.mapColors(particles, particles, threaded.data(), &pool);
+        EXPECT_TRUE(serial == threaded);
+    }
+}
+
+TEST(ParticleSim, defaultctor)
+{
+    ParticleSim sim;
+    EXPECT_TRUE(sim.size() == 0);
+    EXPECT_TRUE(sim.numParticles() == 10);
+    // stepping without a graph should do nothing
+    sim.step(0.01f);
+    EXPECT_TRUE(sim.size() == 0);
+}
+
+TEST(ParticleSim, step)
+{
+    // initialize graph
+    std::vector<ngl::Vec3> points;
+    points.reserve(16);
+    for(size_t i = 0; i < 4; ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            points.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    ParticleSim sim(Graph(points, 3));
+    EXPECT_TRUE(sim.size() == 10);
+    EXPECT_TRUE(sim.goal() < 16);
+    // raise the cap, step spawns up to it
+    sim.setNumParticles(20);
+    sim.step(0.01f);
+    EXPECT_TRUE(sim.size() == 20);
+    // run long enough for particles to arrive and respawn, all stay inside the graph bounds
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        sim.step(0.05f);
+    }
+    EXPECT_TRUE(sim.size() == 20);
+    for(auto p : sim.positions())
+    {
+        EXPECT_TRUE(p.m_x > -0.01f && p.m_x < 3.01f);
+        EXPECT_TRUE(p.m_y > -0.01f && p.m_y < 3.01f);
+    }
+}
+
+TEST(TripleBuffer, handoff)
+{
+    TripleBuffer<std::vector<int>> buffer;
+    // nothing published yet
+    EXPECT_FALSE(buffer.update());
+    EXPECT_TRUE(buffer.front().empty());
+    // the reader only ever sees the latest
+    buffer.back() = {1};
+    buffer.publish();
+    buffer.back() = {2};
+    buffer.publish();
+    EXPECT_TRUE(buffer.update());
+    EXPECT_TRUE(buffer.front() == std::vector<int>({2}));
+    EXPECT_FALSE(buffer.update());
+    EXPECT_TRUE(buffer.front() == std::vector<int>({2}));
+    // writing doesn't touch what the reader holds
+    buffer.back() = {3};
+    EXPECT_TRUE(buffer.front() == std::vector<int>({2}));
+    buffer.publish();
+    EXPECT_TRUE(buffer.update());
+    EXPECT_TRUE(buffer.front() == std::vector<int>({3}));
+
+    // a writer thread publishing as fast as it can, the reader never sees a torn or older frame
+    TripleBuffer<std::vector<int>> frames;
+    const int last = 20000;
+    std::thread writer([&]
+    {
+        for(int i = 1; i <= last; ++i)
+        {
+            frames.back().assign(64, i);
+            frames.publish();
+        }
+    });
+    int seen = 0;
+    bool ordered = true;
+    while(seen < last)
+    {
+        if(frames.update())
+        {
+            auto& f = frames.front();
+            ordered = ordered && f.size() == 64 && f.front() > seen && std::count(f.begin(), f.end(), f.front()) == 64;
+            seen = f.front();
+        }
+    }
+    writer.join();
+    EXPECT_TRUE(ordered);
+}
+
+TEST(ParticleSim, snapshot)
+{
+    // initialize graph
+    std::vector<ngl::Vec3> points;
+    points.reserve(16);
+    for(size_t i = 0; i < 4; ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            points.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    ParticleSim sim(Graph(points, 3));
+    sim.step(0.05f);
+    FrameState frame;
+    sim.snapshot(frame);
+    EXPECT_TRUE(frame.tick == sim.tick());
+    EXPECT_TRUE(frame.goal == sim.goal());
+    EXPECT_TRUE(frame.positions == sim.positions());
+    ASSERT_TRUE(frame.graph);
+    EXPECT_TRUE(frame.graph->revision() == sim.graph().revision());
+    // the graph is only copied again once it changes
+    auto graph = frame.graph;
+    sim.step(0.05f);
+    sim.snapshot(frame);
+    EXPECT_TRUE(frame.graph == graph);
+    EXPECT_TRUE(frame.positions == sim.positions());
+    sim.setGraph(Graph(points, 2));
+    sim.snapshot(frame);
+    EXPECT_TRUE(frame.graph != graph);
+    EXPECT_TRUE(frame.graph->degree() == 2);
+    // the old frame's graph is untouched
+    EXPECT_TRUE(graph->degree() == 3);
+}
+
+TEST(SimulationThread, fixedStep)
+{
+    // initialize graph
+    std::vector<ngl::Vec3> points;
+    points.reserve(16);
+    for(size_t i = 0; i < 4; ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            points.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    ParticleSim sim(Graph(points, 3));
+    TripleBuffer<FrameState> frames;
+    std::atomic<int> published{0};
+    SimulationThread thread(sim, frames, [&] { ++published; });
+    // stopped, commands happen straight away
+    thread.post([](ParticleSim &_sim) { _sim.setNumParticles(5); });
+    EXPECT_TRUE(sim.numParticles() == 5);
+    EXPECT_TRUE(published == 1);
+    EXPECT_TRUE(frames.update());
+    // running, commands happen on the simulation's thread between steps
+    thread.setTickRate(1000.0);
+    auto begin = std::chrono::steady_clock::now();
+    thread.start();
+    EXPECT_TRUE(thread.isRunning());
+    std::thread::id ranOn;
+    thread.post([&](ParticleSim &_sim) { ranOn = std::this_thread::get_id(); _sim.setNumParticles(8); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    thread.stop();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    EXPECT_FALSE(thread.isRunning());
+    EXPECT_TRUE(ranOn != std::this_thread::get_id());
+    EXPECT_TRUE(sim.numParticles() == 8);
+    // only whole fixed steps, never more than real time allows
+    EXPECT_TRUE(thread.ticks() > 0);
+    EXPECT_TRUE(sim.tick() == thread.ticks());
+    EXPECT_TRUE(std::abs(sim.time() - 0.001 * thread.ticks()) < 1e-6);
+    EXPECT_TRUE(thread.ticks() + thread.dropped() <= elapsed * 1000.0 + 1.0);
+    auto histogram = thread.histogram();
+    uint64_t timed = 0;
+    for(auto h : histogram)
+    {
+        timed += h;
+    }
+    EXPECT_TRUE(timed == thread.ticks());
+    // the last frame is the state it stopped in
+    EXPECT_TRUE(frames.update());
+    EXPECT_TRUE(frames.front().tick == sim.tick());
+    EXPECT_TRUE(frames.front().positions == sim.positions());
+}
+
+TEST(ParticleKernel, simdMatchesScalar)
+{
+    // odd count so the vector kernels also run their scalar tail
+    size_t n = 1003;
+    std::vector<float> pos(n * 3), dir(n * 3), target(n * 3), speed(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        float f = static_cast<float>(i);
+        pos[i] = 0.0f; pos[n + i] = 0.5f; pos[2 * n + i] = 1.0f;
+        dir[i] = 0.6f; dir[n + i] = 0.0f; dir[2 * n + i] = -0.8f;
+        target[i] = 0.6f * f * 0.001f; target[n + i] = 0.5f; target[2 * n + i] = 1.0f - 0.8f * f * 0.001f;
+        speed[i] = 0.25f + 0.5f * (i % 7) / 7.0f;
+    }
+    auto run = [&](SimdLevel _level, std::vector<float> &_pos, std::vector<uint8_t> &_arrived)
+    {
+        _pos = pos;
+        _arrived.assign(n, 2);
+        ParticleStepData data = {&_pos[0], &_pos[n], &_pos[2 * n],
+                                 &dir[0], &dir[n], &dir[2 * n],
+                                 &target[0], &target[n], &target[2 * n],
+                                 speed.data(), _arrived.data(), n};
+        return advanceParticles(data, 0.7f, _level);
+    };
+    std::vector<float> scalarPos;
+    std::vector<uint8_t> scalarArrived;
+    auto scalarCount = run(SimdLevel::Scalar, scalarPos, scalarArrived);
+    EXPECT_TRUE(scalarCount > 0 && scalarCount < n);
+    EXPECT_TRUE(scalarArrived[0] == 1);
+    EXPECT_TRUE(scalarPos[0] == 0.0f);
+    EXPECT_TRUE(scalarArrived[n - 1] == 0);
+    // every kernel the cpu supports must agree bit for bit
+    for(auto level : {SimdLevel::AVX2, SimdLevel::AVX512})
+    {
+        if(static_cast<int>(level) > static_cast<int>(detectSimdLevel()))
+        {
+            continue;
+        }
+        std::vector<float> simdPos;
+        std::vector<uint8_t> simdArrived;
+        EXPECT_TRUE(run(level, simdPos, simdArrived) == scalarCount);
+        EXPECT_TRUE(simdPos == scalarPos);
+        EXPECT_TRUE(simdArrived == scalarArrived);
+    }
+}
+
+TEST(KdTree, nearest)
+{
+    // random points, every query must agree with checking them all
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<ngl::Vec3> points(500);
+    for(auto& p : points)
+    {
+        p = ngl::Vec3(unit(gen), unit(gen), unit(gen));
+    }
+    KdTree tree(points);
+    EXPECT_TRUE(tree.size() == 500);
+    std::vector<ngl::Vec3> queries(200);
+    for(auto& q : queries)
+    {
+        q = ngl::Vec3(unit(gen), unit(gen), unit(gen)) * 1.2f - ngl::Vec3(0.1f);
+    }
+    ThreadPool pool(4);
+    auto found = tree.nearest(queries, &pool);
+    for(size_t i = 0; i < queries.size(); ++i)
+    {
+        size_t best = 0;
+        for(size_t p = 1; p < points.size(); ++p)
+        {
+            if((points[p] - queries[i]).lengthSquared() < (points[best] - queries[i]).lengthSquared())
+            {
+                best = p;
+            }
+        }
+        EXPECT_TRUE(found[i] == best);
+        EXPECT_TRUE(tree.nearest(queries[i]) == best);
+    }
+    // duplicates resolve to the first copy
+    std::vector<ngl::Vec3> same(8, ngl::Vec3(0.5f));
+    EXPECT_TRUE(KdTree(same).nearest(ngl::Vec3(0.0f)) == 0);
+}
+
+TEST(KdTree, kNearest)
+{
+    // the k closest, in order, must match sorting every point by distance
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<ngl::Vec3> points(300);
+    for(auto& p : points)
+    {
+        p = ngl::Vec3(unit(gen), unit(gen), unit(gen));
+    }
+    KdTree tree(points);
+    size_t ids[8];
+    float dists[8];
+    for(size_t q = 0; q < 100; ++q)
+    {
+        ngl::Vec3 pos(unit(gen), unit(gen), unit(gen));
+        std::vector<size_t> order(points.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t _a, size_t _b)
+        {
+            auto da = (points[_a] - pos).lengthSquared();
+            auto db = (points[_b] - pos).lengthSquared();
+            return da < db || (da == db && _a < _b);
+        });
+        EXPECT_TRUE(tree.nearest(pos, 8, ids, dists) == 8);
+        for(size_t k = 0; k < 8; ++k)
+        {
+            EXPECT_TRUE(ids[k] == order[k]);
+            EXPECT_TRUE(dists[k] == (points[order[k]] - pos).lengthSquared());
+        }
+        EXPECT_TRUE(tree.nearest(pos, 1, ids, dists) == 1);
+        EXPECT_TRUE(ids[0] == tree.nearest(pos));
+    }
+    // building over threads lays the tree out the same
+    std::vector<ngl::Vec3> many(20000);
+    for(auto& p : many)
+    {
+        p = ngl::Vec3(unit(gen), unit(gen), unit(gen));
+    }
+    ThreadPool pool(4);
+    KdTree serial(many);
+    KdTree threaded(many, &pool);
+    for(auto& p : points)
+    {
+        EXPECT_TRUE(serial.nearest(p) == threaded.nearest(p));
+    }
+    // fewer points than asked for
+    std::vector<ngl::Vec3> three(3, ngl::Vec3(0.5f));
+    EXPECT_TRUE(KdTree(three).nearest(ngl::Vec3(0.0f), 8, ids, dists) == 3);
+    EXPECT_TRUE(ids[0] == 0 && ids[1] == 1 && ids[2] == 2);
+    EXPECT_TRUE(KdTree().nearest(ngl::Vec3(0.0f), 8, ids, dists) == 0);
+}
+
+TEST(DynamicKdTree, insert)
+{
+    // built half up front and half a point at a time, queries must match sorting every point not skipped
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<ngl::Vec3> points(500);
+    for(auto& p : points)
+    {
+        p = ngl::Vec3(unit(gen), unit(gen), unit(gen));
+    }
+    DynamicKdTree tree(std::vector<ngl::Vec3>(points.begin(), points.begin() + 200));
+    for(size_t i = 200; i < points.size(); ++i)
+    {
+        tree.insert(points[i], i);
+    }
+    EXPECT_TRUE(tree.size() == 500);
+    // the first 200 sit in the 256 level until the 256th insert carries into it, the last 44 are 101100 in binary
+    EXPECT_TRUE(tree.numLevels() == 4);
+    auto skip = [](size_t _id, const ngl::Vec3 &) { return _id % 3 == 0; };
+    size_t ids[8];
+    float dists[8];
+    for(size_t q = 0; q < 100; ++q)
+    {
+        ngl::Vec3 pos(unit(gen), unit(gen), unit(gen));
+        std::vector<size_t> order;
+        for(size_t i = 0; i < points.size(); ++i)
+        {
+            if(!skip(i, points[i]))
+            {
+                order.push_back(i);
+            }
+        }
+        std::sort(order.begin(), order.end(), [&](size_t _a, size_t _b)
+        {
+            auto da = (points[_a] - pos).lengthSquared();
+            auto db = (points[_b] - pos).lengthSquared();
+            return da < db || (da == db && _a < _b);
+        });
+        EXPECT_TRUE(tree.nearest(pos, 8, ids, dists, skip) == 8);
+        for(size_t k = 0; k < 8; ++k)
+        {
+            EXPECT_TRUE(ids[k] == order[k]);
+            EXPECT_TRUE(dists[k] == (points[order[k]] - pos).lengthSquared());
+        }
+    }
+    // exact positions, lowest id wins and skipped ones are passed over
+    size_t id;
+    EXPECT_TRUE(tree.find(points[321], id) && id == 321);
+    tree.insert(points[321], 900);
+    tree.insert(points[321], 7);
+    EXPECT_TRUE(tree.find(points[321], id) && id == 7);
+    EXPECT_TRUE(tree.find(points[321], id, [](size_t _id, const ngl::Vec3 &) { return _id < 321; }) && id == 321);
+    EXPECT_FALSE(tree.find(ngl::Vec3(2.0f), id));
+    // the same id twice is only reported once
+    EXPECT_TRUE(tree.nearest(points[321], 3, ids, dists) == 3);
+    EXPECT_TRUE(ids[0] == 7 && ids[1] == 321 && ids[2] == 900);
+    // copies share their levels, inserting into one leaves the other alone
+    DynamicKdTree copy = tree;
+    copy.insert(ngl::Vec3(5.0f), 1000);
+    EXPECT_TRUE(copy.nearest(ngl::Vec3(5.0f), 1, ids, dists) == 1 && ids[0] == 1000);
+    EXPECT_TRUE(tree.nearest(ngl::Vec3(5.0f), 1, ids, dists) == 1 && ids[0] != 1000);
+    EXPECT_TRUE(DynamicKdTree().nearest(ngl::Vec3(0.0f), 8, ids, dists) == 0);
+}
+
+TEST(ThreadPool, parallelFor)
+{
+    ThreadPool pool(4);
+    EXPECT_TRUE(pool.size() == 4);
+    // every index is visited exactly once, whatever thread picks up the chunk
+    std::vector<int> visits(10007, 0);
+    pool.parallelFor(visits.size(), 64, [&](size_t _begin, size_t _end)
+    {
+        for(size_t i = _begin; i < _end; ++i)
+        {
+            ++visits[i];
+        }
+    });
+    EXPECT_TRUE(std::count(visits.begin(), visits.end(), 1) == static_cast<long>(visits.size()));
+}
+
+TEST(ParticleSim, threadCountDeterminism)
+{
+    // initialize graph
+    std::vector<ngl::Vec3> points;
+    points.reserve(100);
+    for(size_t i = 0; i < 10; ++i)
+    {
+        for(size_t j = 0; j < 10; ++j)
+        {
+            points.push_back(ngl::Vec3(0.1f * i, 0.1f * j, 0.0f));
+        }
+    }
+    Graph g(points, 3);
+    // same seed, different thread counts, must give identical particles
+    auto run = [&](size_t _threads)
+    {
+        ParticleSim sim;
+        sim.setSeed(1234);
+        sim.setNumThreads(_threads);
+        sim.setNumParticles(5000);
+        sim.setRandomGoal(true);
+        sim.setGraph(g);
+        for(size_t i = 0; i < 200; ++i)
+        {
+            sim.step(0.01f);
+        }
+        return sim.positions();
+    };
+    auto single = run(1);
+    auto multi = run(4);
+    ASSERT_TRUE(single.size() == multi.size());
+    for(size_t i = 0; i < single.size(); ++i)
+    {
+        EXPECT_TRUE(single[i].m_x == multi[i].m_x && single[i].m_y == multi[i].m_y && single[i].m_z == multi[i].m_z);
+    }
+}
+
+TEST(ParticleSim, massRetirement)
+{
+    // two nodes, whichever is the goal every particle starts on the other one
+    std::vector<ngl::Vec3> points = {ngl::Vec3(0.0f), ngl::Vec3(1.0f, 0.0f, 0.0f)};
+    ParticleSim sim;
+    sim.setNumParticles(10000);
+    sim.setGraph(Graph(points, 1));
+    EXPECT_TRUE(sim.size() == 10000);
+    auto start = sim.position(0);
+    // a big enough step lands everyone on the goal at once, they are all retired and respawned
+    sim.step(10.0f);
+    EXPECT_TRUE(sim.size() == 10000);
+    for(auto p : sim.positions())
+    {
+        EXPECT_TRUE(p == start);
+    }
+}
+
+TEST(Philox, knownAnswers)
+{
+    // test vectors from the Random123 distribution
+    auto r = Philox(0)({{0, 0, 0, 0}});
+    EXPECT_TRUE(r[0] == 0x6627e8d5u && r[1] == 0xe169c58du && r[2] == 0xbc57ac4cu && r[3] == 0x9b00dbd8u);
+    r = Philox(0x299f31d0a4093822ull)({{0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u}});
+    EXPECT_TRUE(r[0] == 0xd16cfe09u && r[1] == 0x94fdccebu && r[2] == 0x5001e420u && r[3] == 0x24126ea1u);
+    // ranged draws stay in range
+    Philox rng(42);
+    for(uint64_t i = 0; i < 1000; ++i)
+    {
+        EXPECT_TRUE(rng.index(7, i, 0) < 7);
+        auto u = rng.uniform(i, 1);
+        EXPECT_TRUE(u >= 0.0f && u < 1.0f);
+    }
+}
+
+TEST(ParticleSim, seedReplay)
+{
+    // initialize graph
+    std::vector<ngl::Vec3> points;
+    points.reserve(16);
+    for(size_t i = 0; i < 4; ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            points.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    ParticleSim sim(Graph(points, 3), 99);
+    EXPECT_TRUE(sim.seed() == 99);
+    sim.setRandomGoal(true);
+    for(size_t i = 0; i < 300; ++i)
+    {
+        sim.step(0.01f);
+    }
+    auto first = sim.positions();
+    // restarting with the recorded seed replays the same run
+    sim.setSeed(sim.seed());
+    EXPECT_TRUE(sim.tick() == 0);
+    for(size_t i = 0; i < 300; ++i)
+    {
+        sim.step(0.01f);
+    }
+    EXPECT_TRUE(sim.positions() == first);
+}
+
+TEST(ParticleSim, eventDriven)
+{
+    // initialize graph
+    std::vector<ngl::Vec3> points;
+    points.reserve(16);
+    for(size_t i = 0; i < 4; ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            points.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    ParticleSim sim(Graph(points, 3), 7);
+    sim.setNumParticles(50);
+    sim.step(0.01f);
+    // switching keeps everyone where they are
+    auto before = sim.positions();
+    sim.setMode(ParticleSim::Mode::EventDriven);
+    EXPECT_TRUE(sim.mode() == ParticleSim::Mode::EventDriven);
+    EXPECT_TRUE(sim.positions() == before);
+    // no edge is shorter than 1, so a short step moves everyone exactly speed * dt
+    sim.step(0.1f);
+    auto after = sim.positions();
+    for(size_t i = 0; i < after.size(); ++i)
+    {
+        EXPECT_NEAR((after[i] - before[i]).length(), 0.05f, 1e-4f);
+    }
+    // run long enough for arrivals, retirements and respawns
+    for(size_t i = 0; i < 500; ++i)
+    {
+        sim.step(0.05f);
+    }
+    EXPECT_TRUE(sim.size() == 50);
+    for(auto p : sim.positions())
+    {
+        EXPECT_TRUE(p.m_x > -0.01f && p.m_x < 3.01f);
+        EXPECT_TRUE(p.m_y > -0.01f && p.m_y < 3.01f);
+    }
+    // and back again
+    before = sim.positions();
+    sim.setMode(ParticleSim::Mode::Stepped);
+    EXPECT_TRUE(sim.positions() == before);
+}
+
+TEST(ParticleSim, unreachableStarts)
+{
+    // two squares too far apart to be linked, half the nodes can never reach the goal
+    std::vector<ngl::Vec3> points;
+    points.reserve(8);
+    for(float x : {0.0f, 10.0f})
+    {
+        for(size_t i = 0; i < 2; ++i)
+        {
+            for(size_t j = 0; j < 2; ++j)
+            {
+                points.push_back(ngl::Vec3(x + 1.0f * i, 1.0f * j, 0.0f));
+            }
+        }
+    }
+    ParticleSim sim(Graph(points, 3), 5);
+    sim.setMode(ParticleSim::Mode::EventDriven);
+    sim.setNumParticles(20);
+    auto goalSide = sim.graph().pos(sim.goal()).m_x < 5.0f;
+    for(size_t i = 0; i < 300; ++i)
+    {
+        sim.step(0.05f);
+        // nobody spawns where they'd be stuck, so the cap is always filled by particles on the goal's side
+        EXPECT_TRUE(sim.size() == 20);
+        for(auto p : sim.positions())
+        {
+            EXPECT_TRUE((p.m_x < 5.0f) == goalSide);
+        }
+    }
+}
+
+TEST(ParticleSim, removedNodes)
+{
+    // allocate initializer list
+    std::vector<ngl::Vec3> points;
+    points.reserve(16);
+    for(size_t i = 0; i < 4; ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            points.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    // take out every other node, the ids stay behind with nothing at them
+    Graph g(points, 5);
+    for(size_t n = 0; n < 16; n += 2)
+    {
+        g.removeNode(n);
+    }
+    ParticleSim sim(g, 7);
+    sim.setNumParticles(10);
+    for(size_t i = 0; i < 100; ++i)
+    {
+        EXPECT_TRUE(sim.graph().isNode(sim.goal()));
+        sim.step(0.05f);
+        sim.changeGoal();
+    }
+}
+
+TEST(Timeline, evaluate)
+{
+    Timeline tl;
+    auto path = tl.addPath({ngl::Vec3(0.0f), ngl::Vec3(1.0f, 0.0f, 0.0f), ngl::Vec3(1.0f, 2.0f, 0.0f)});
+    EXPECT_TRUE(tl.pathLength(path) == 3.0f);
+    auto a = tl.addTrack(path, 1.0, 1.0f);
+    auto b = tl.addTrack(path, 2.0, 0.5f);
+    EXPECT_TRUE(tl.duration() == 8.0);
+    // positions are a pure function of time, in any order
+    EXPECT_TRUE(tl.evaluate(a, 3.5) == ngl::Vec3(1.0f, 1.5f, 0.0f));
+    EXPECT_TRUE(tl.evaluate(a, 1.5) == ngl::Vec3(0.5f, 0.0f, 0.0f));
+    EXPECT_TRUE(tl.evaluate(b, 4.0) == ngl::Vec3(1.0f, 0.0f, 0.0f));
+    EXPECT_TRUE(tl.tracksAt(0.5).empty());
+    EXPECT_TRUE(tl.tracksAt(1.5).size() == 1);
+    EXPECT_TRUE(tl.tracksAt(3.0).size() == 2);
+    EXPECT_TRUE(tl.tracksAt(5.0).size() == 1);
+    // cutting a track short
+    tl.endTrack(b, 3.0);
+    EXPECT_TRUE(tl.tracksAt(3.0).size() == 1);
+    EXPECT_FALSE(tl.isAlive(b, 3.0));
+}
+
+TEST(ParticleSim, recordedPlayback)
+{
+    // initialize graph
+    std::vector<ngl::Vec3> points;
+    points.reserve(16);
+    for(size_t i = 0; i < 4; ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            points.push_back(ngl::Vec3(1.0f * i, 1.0f * j, 0.0f));
+        }
+    }
+    ParticleSim sim(Graph(points, 3), 11);
+    sim.setNumParticles(30);
+    sim.setRandomGoal(true);
+    sim.setMode(ParticleSim::Mode::EventDriven);
+    sim.setRecording(true);
+    // keep a few frames to seek back to afterwards
+    std::vector<std::pair<double, std::vector<ngl::Vec3>>> frames;
+    double paused = 0.0;
+    for(size_t i = 0; i < 400; ++i)
+    {
+        // a gap in the recording with a goal change inside it
+        if(i == 150)
+        {
+            sim.setRecording(false);
+        }
+        if(i == 170)
+        {
+            sim.changeGoal();
+            paused = sim.time();
+        }
+        if(i == 200)
+        {
+            sim.setRecording(true);
+        }
+        sim.step(0.03f);
+        if(i % 50 == 7 && sim.isRecording())
+        {
+            frames.push_back(std::make_pair(sim.time(), sim.positions()));
+        }
+    }
+    // nothing was recorded in the gap, and nobody carries on along their old route through it
+    EXPECT_TRUE(sim.timeline().positionsAt(paused).empty());
+    ThreadPool pool(2);
+    for(auto& f : frames)
+    {
+        auto played = sim.timeline().positionsAt(f.first, &pool);
+        ASSERT_TRUE(played.size() == f.second.size());
+        // same particles, not necessarily in the same order
+        for(auto p : f.second)
+        {
+            auto match = std::find_if(played.begin(), played.end(), [&](const ngl::Vec3 &_q)
+            {
+                return (_q - p).length() < 1e-3f;
+            });
+            EXPECT_TRUE(match != played.end());
+        }
+    }
+}
@@ -1,10 +1,24 @@
 TARGET=test
 SOURCES+= main.cpp \
           ../das/src/Graph.cpp \
-          ../das/src/ColorTeapot.cpp
+          ../das/src/GraphBuilder.cpp \
+          ../das/src/GraphVersions.cpp \
+          ../das/src/KdTree.cpp \
+          ../das/src/DynamicKdTree.cpp \
+          ../das/src/ColorTeapot.cpp \
+          ../das/src/ColorMesh.cpp \
+          ../das/src/MeshFile.cpp \
+          ../das/src/MeshLoader.cpp \
+          ../das/src/ParticleSim.cpp \
+          ../das/src/ParticleKernel.cpp \
+          ../das/src/SimulationThread.cpp \
+          ../das/src/ThreadPool.cpp \
+          ../das/src/Timeline.cpp
 #          ../clothSim/src/Cloth.cpp \
 
 LIBS+= -lgtest
+# tests run from anywhere, so point them at the assets and build the teapot in to compare with
+DEFINES+= DAS_EMBED_TEAPOT DAS_ASSET_DIR=\\\"$$PWD/../das/assets\\\"
 INCLUDEPATH+= ../das/include
 
 # Following code written by Jon Macey